@@ -21,6 +21,11 @@ static inline void native_queued_spin_unlock(struct qspinlock *lock)
 extern void native_queued_spin_lock_slowpath(struct qspinlock *lock, u32 val);
 extern void __pv_init_lock_hash(void);
 extern void __pv_queued_spin_lock_slowpath(struct qspinlock *lock, u32 val);
+#ifdef CONFIG_NUMA_AWARE_SPINLOCKS
+extern void __cna_queued_spin_lock_slowpath(struct qspinlock *lock, u32 val);
+extern void cna_configure_spin_lock_slowpath(void);
+extern bool cna_spin_lock_ready(void);
+#endif
 extern void __raw_callee_save___pv_queued_spin_unlock(struct qspinlock *lock);
 
 static inline void queued_spin_lock_slowpath(struct qspinlock *lock, u32 val)
@@ -49,6 +49,7 @@ struct smp_ops {
 	void (*stop_other_cpus)(int wait);
 	void (*crash_stop_other_cpus)(void);
 	void (*smp_send_reschedule)(int cpu);
+	void (*smp_send_reschedule_mask)(const struct cpumask *mask);
 
 	int (*cpu_up)(unsigned cpu, struct task_struct *tidle);
 	int (*cpu_disable)(void);
@@ -115,6 +116,20 @@ static inline void smp_send_reschedule(int cpu)
 	smp_ops.smp_send_reschedule(cpu);
 }
 
+static inline void smp_send_reschedule_mask(const struct cpumask *mask)
+{
+	int cpu;
+
+	if (smp_ops.smp_send_reschedule_mask) {
+		smp_ops.smp_send_reschedule_mask(mask);
+		return;
+	}
+
+	for_each_cpu(cpu, mask)
+		smp_ops.smp_send_reschedule(cpu);
+}
+#define smp_send_reschedule_mask smp_send_reschedule_mask
+
 static inline void arch_send_call_function_single_ipi(int cpu)
 {
 	smp_ops.send_call_func_single_ipi(cpu);
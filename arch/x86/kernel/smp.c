@@ -131,6 +131,15 @@ static void native_smp_send_reschedule(int cpu)
 	apic->send_IPI(cpu, RESCHEDULE_VECTOR);
 }
 
+/*
+ * Used by the scheduler to kick a batch of remote wakeups at once; in
+ * cluster/logical mode the APIC driver turns this into one IPI per cluster.
+ */
+static void native_smp_send_reschedule_mask(const struct cpumask *mask)
+{
+	apic->send_IPI_mask(mask, RESCHEDULE_VECTOR);
+}
+
 void native_send_call_func_single_ipi(int cpu)
 {
 	apic->send_IPI(cpu, CALL_FUNCTION_SINGLE_VECTOR);
@@ -354,6 +363,7 @@ struct smp_ops smp_ops = {
 	.crash_stop_other_cpus	= kdump_nmi_shootdown_cpus,
 #endif
 	.smp_send_reschedule	= native_smp_send_reschedule,
+	.smp_send_reschedule_mask = native_smp_send_reschedule_mask,
 
 	.cpu_up			= native_cpu_up,
 	.cpu_die		= native_cpu_die,
@@ -1365,6 +1365,21 @@ __do_page_fault(struct pt_regs *regs, unsigned long error_code,
 	if (error_code & PF_INSTR)
 		flags |= FAULT_FLAG_INSTRUCTION;
 
+	/*
+	 * Not-present faults on anonymous memory can usually be resolved
+	 * without mmap_sem, so that they do not queue up behind a writer
+	 * doing mmap()/munmap()/mprotect() in another thread.
+	 */
+	if (!(error_code & (PF_PROT | PF_RSVD | PF_PK))) {
+		fault = handle_speculative_fault(mm, address, flags);
+		if (fault != VM_FAULT_RETRY) {
+			tsk->min_flt++;
+			perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MIN, 1,
+				      regs, address);
+			return;
+		}
+	}
+
 	/*
 	 * When running in the kernel we expect faults to occur only to
 	 * addresses in user space.  All other faults represent errors in
@@ -80,6 +80,7 @@ struct notifier_block;
 #ifdef CONFIG_SMP
 extern bool cpuhp_tasks_frozen;
 int cpu_up(unsigned int cpu);
+void bringup_nonboot_cpus(unsigned int setup_max_cpus);
 void notify_cpu_starting(unsigned int cpu);
 extern void cpu_maps_update_begin(void);
 extern void cpu_maps_update_done(void);
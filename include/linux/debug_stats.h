@@ -0,0 +1,105 @@
+/*
+ * Scaffolding shared by the debugfs statistics of the lock contention
+ * profiler, the workqueue statistics and timer batching: the "enable" and
+ * "reset" files, per-cpu hash tables accounting time to call sites, and
+ * log2 histograms of durations.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#ifndef _LINUX_DEBUG_STATS_H
+#define _LINUX_DEBUG_STATS_H
+
+#include <linux/jump_label.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/time64.h>
+#include <linux/types.h>
+
+struct dentry;
+struct seq_file;
+
+/*
+ * "enable" writes 1/0 to flip @key, "reset" calls @reset; both, and any
+ * reader of the statistics that wants to, serialize on @lock.  Either of
+ * @key and @reset may be NULL to leave out the corresponding file.
+ */
+struct debug_stats_ctl {
+	struct static_key	*key;
+	struct mutex		*lock;
+	void			(*reset)(void);
+};
+
+/*
+ * Log2 histograms of durations: bucket 0 counts those shorter than 1us,
+ * bucket i those in [2^(i-1), 2^i) us and the last of @nr buckets all
+ * longer ones.
+ */
+static inline unsigned int debug_stats_log2_bucket(u64 ns, unsigned int nr)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+
+	return us ? min_t(unsigned int, ilog2(us) + 1, nr - 1) : 0;
+}
+
+#ifdef CONFIG_DEBUG_STATS
+extern void debug_stats_create_ctl(struct dentry *dir,
+				   struct debug_stats_ctl *ctl);
+extern void debug_stats_seq_hist(struct seq_file *m, const unsigned int *hist,
+				 unsigned int nr);
+#else
+static inline void debug_stats_create_ctl(struct dentry *dir,
+					  struct debug_stats_ctl *ctl) { }
+static inline void debug_stats_seq_hist(struct seq_file *m,
+					const unsigned int *hist,
+					unsigned int nr) { }
+#endif
+
+/*
+ * A per-cpu open addressing hash table of call sites.  Users embed
+ * struct callsite_entry at the start of their own entries and describe
+ * those with @entry_size; @merge, if set, folds the fields beyond it
+ * when the per-cpu tables are merged.
+ */
+struct callsite_entry {
+	unsigned long	ip;		/* 0 for a free slot */
+	unsigned int	tag;		/* tells apart entries of one ip */
+	u64		count;
+	u64		total_ns;
+	u64		max_ns;
+};
+
+struct callsite_table {
+	size_t		entry_size;
+	unsigned int	hash_bits;
+	void		(*merge)(struct callsite_entry *dst,
+				 const struct callsite_entry *src);
+
+	void		**tables;	/* per possible cpu */
+	unsigned long __percpu *dropped;
+};
+
+extern int callsite_table_init(struct callsite_table *t);
+extern void callsite_table_destroy(struct callsite_table *t);
+extern struct callsite_entry *
+callsite_table_lookup(struct callsite_table *t, unsigned long ip,
+		      unsigned int tag);
+extern void *callsite_table_alloc_merged(struct callsite_table *t);
+extern int callsite_table_merge(struct callsite_table *t, void *merged,
+				unsigned long *dropped);
+extern void callsite_table_reset(struct callsite_table *t);
+
+static inline void callsite_entry_add(struct callsite_entry *e, u64 delta)
+{
+	e->count++;
+	e->total_ns += delta;
+	if (delta > e->max_ns)
+		e->max_ns = delta;
+}
+
+#endif /* _LINUX_DEBUG_STATS_H */
@@ -37,6 +37,7 @@ struct kernel_cpustat {
 struct kernel_stat {
 	unsigned long irqs_sum;
 	unsigned int softirqs[NR_SOFTIRQS];
+	u64 softirq_time[NR_SOFTIRQS];	/* nanoseconds */
 };
 
 DECLARE_PER_CPU(struct kernel_stat, kstat);
@@ -63,6 +64,16 @@ static inline unsigned int kstat_softirqs_cpu(unsigned int irq, int cpu)
        return kstat_cpu(cpu).softirqs[irq];
 }
 
+static inline void kstat_add_softirq_time_this_cpu(unsigned int irq, u64 delta)
+{
+	__this_cpu_add(kstat.softirq_time[irq], delta);
+}
+
+static inline u64 kstat_softirq_time_cpu(unsigned int irq, int cpu)
+{
+	return kstat_cpu(cpu).softirq_time[irq];
+}
+
 /*
  * Number of interrupts per specific IRQ source, since bootup
  */
@@ -28,6 +28,7 @@
 #include <linux/eventfd.h>
 #include <linux/mmzone.h>
 #include <linux/writeback.h>
+#include <linux/page_idle.h>
 #include <linux/page-flags.h>
 
 struct mem_cgroup;
@@ -141,6 +142,11 @@ struct mem_cgroup_thresholds {
 	 * It must be able to store at least primary->size - 1 entries.
 	 */
 	struct mem_cgroup_threshold_ary *spare;
+	/*
+	 * RCU grace-period cookie taken when @spare was unpublished; it
+	 * may only be reused or freed once that grace period has elapsed.
+	 */
+	unsigned long spare_gp;
 };
 
 enum memcg_kmem_state {
@@ -177,6 +183,9 @@ struct mem_cgroup {
 	/* Range enforcement for interrupt charges */
 	struct work_struct high_work;
 
+	/* Pages reclaimed by the last write to "memory.reclaim" */
+	unsigned long reclaim_last;
+
 	unsigned long soft_limit;
 
 	/* vmpressure notifications */
@@ -257,6 +266,12 @@ struct mem_cgroup {
 	struct list_head event_list;
 	spinlock_t event_list_lock;
 
+#ifdef CONFIG_IDLE_PAGE_TRACKING
+	/* Idle page histograms: being built, and of the last full scan */
+	struct idle_page_stats idle_scan;
+	struct idle_page_stats idle_stats;
+#endif
+
 	struct mem_cgroup_per_node *nodeinfo[0];
 	/* WARNING: nodeinfo must be the last member here */
 };
@@ -93,6 +93,9 @@ static inline void __ClearPageMovable(struct page *page)
 extern bool pmd_trans_migrating(pmd_t pmd);
 extern int migrate_misplaced_page(struct page *page,
 				  struct vm_area_struct *vma, int node);
+extern unsigned long numa_migrate_hot_pages(struct vm_area_struct *vma,
+				unsigned long start, unsigned long end,
+				int target_nid, unsigned long *nr_migrated);
 #else
 static inline bool pmd_trans_migrating(pmd_t pmd)
 {
@@ -103,6 +106,12 @@ static inline int migrate_misplaced_page(struct page *page,
 {
 	return -EAGAIN; /* can't migrate now */
 }
+static inline unsigned long numa_migrate_hot_pages(struct vm_area_struct *vma,
+				unsigned long start, unsigned long end,
+				int target_nid, unsigned long *nr_migrated)
+{
+	return 0;
+}
 #endif /* CONFIG_NUMA_BALANCING */
 
 #if defined(CONFIG_NUMA_BALANCING) && defined(CONFIG_TRANSPARENT_HUGEPAGE)
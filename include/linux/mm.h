@@ -1306,6 +1306,42 @@ static inline int fixup_user_fault(struct task_struct *tsk,
 }
 #endif
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+extern int handle_speculative_fault(struct mm_struct *mm,
+				    unsigned long address, unsigned int flags);
+
+static inline void vm_sequence_init(struct vm_area_struct *vma)
+{
+	seqcount_init(&vma->vm_sequence);
+}
+
+/*
+ * Writers hold mmap_sem for write, vm_sequence only tells speculative
+ * faults that the vma changed under them.  mmap_sem already serializes
+ * the writers, and __vma_adjust() nests two vmas while unlinked vmas
+ * are freed with an odd count, so the count is not lockdep tracked.
+ */
+static inline void vm_write_begin(struct vm_area_struct *vma)
+{
+	raw_write_seqcount_begin(&vma->vm_sequence);
+}
+
+static inline void vm_write_end(struct vm_area_struct *vma)
+{
+	raw_write_seqcount_end(&vma->vm_sequence);
+}
+#else
+static inline int handle_speculative_fault(struct mm_struct *mm,
+					   unsigned long address,
+					   unsigned int flags)
+{
+	return VM_FAULT_RETRY;
+}
+static inline void vm_sequence_init(struct vm_area_struct *vma) {}
+static inline void vm_write_begin(struct vm_area_struct *vma) {}
+static inline void vm_write_end(struct vm_area_struct *vma) {}
+#endif
+
 extern int access_process_vm(struct task_struct *tsk, unsigned long addr, void *buf, int len,
 		unsigned int gup_flags);
 extern int access_remote_vm(struct mm_struct *mm, unsigned long addr,
@@ -7,6 +7,22 @@
 
 #ifdef CONFIG_IDLE_PAGE_TRACKING
 
+/*
+ * Working-set estimation: the kidled scanner ages pages by the number
+ * of consecutive scans they were found idle in, and sorts them into
+ * these buckets (in scans) per memory cgroup.
+ */
+#define KIDLED_NR_BUCKETS	8
+
+struct idle_page_stats {
+	/* [0] anon, [1] file */
+	unsigned long nr_pages[2][KIDLED_NR_BUCKETS];
+};
+
+extern const unsigned int kidled_bucket_age[KIDLED_NR_BUCKETS];
+extern unsigned int kidled_scan_period;
+extern unsigned long kidled_full_scans;
+
 #ifdef CONFIG_64BIT
 static inline bool page_is_young(struct page *page)
 {
@@ -48,6 +48,19 @@ static inline void cond_synchronize_rcu(unsigned long oldstate)
 	might_sleep();
 }
 
+unsigned long start_poll_synchronize_sched(void);
+bool poll_state_synchronize_sched(unsigned long oldstate);
+
+static inline unsigned long start_poll_synchronize_rcu(void)
+{
+	return start_poll_synchronize_sched();
+}
+
+static inline bool poll_state_synchronize_rcu(unsigned long oldstate)
+{
+	return poll_state_synchronize_sched(oldstate);
+}
+
 static inline unsigned long get_state_synchronize_sched(void)
 {
 	return 0;
@@ -92,6 +105,11 @@ static inline void kfree_call_rcu(struct rcu_head *head,
 	call_rcu(head, func);
 }
 
+static inline void call_rcu_lazy(struct rcu_head *head, rcu_callback_t func)
+{
+	call_rcu(head, func);
+}
+
 #define rcu_note_context_switch(preempt) \
 	do { \
 		rcu_sched_qs(); \
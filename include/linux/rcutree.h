@@ -49,6 +49,7 @@ void synchronize_sched_expedited(void);
 void synchronize_rcu_expedited(void);
 
 void kfree_call_rcu(struct rcu_head *head, rcu_callback_t func);
+void call_rcu_lazy(struct rcu_head *head, rcu_callback_t func);
 
 /**
  * synchronize_rcu_bh_expedited - Brute-force RCU-bh grace period
@@ -75,8 +76,12 @@ void rcu_barrier(void);
 void rcu_barrier_bh(void);
 void rcu_barrier_sched(void);
 unsigned long get_state_synchronize_rcu(void);
+unsigned long start_poll_synchronize_rcu(void);
+bool poll_state_synchronize_rcu(unsigned long oldstate);
 void cond_synchronize_rcu(unsigned long oldstate);
 unsigned long get_state_synchronize_sched(void);
+unsigned long start_poll_synchronize_sched(void);
+bool poll_state_synchronize_sched(unsigned long oldstate);
 void cond_synchronize_sched(unsigned long oldstate);
 
 extern unsigned long rcutorture_testseq;
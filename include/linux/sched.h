@@ -457,6 +457,23 @@ struct sched_dl_entity {
 	struct hrtimer			dl_timer;
 };
 
+#ifdef CONFIG_UCLAMP_TASK
+enum uclamp_id {
+	UCLAMP_MIN = 0,
+	UCLAMP_MAX,
+	UCLAMP_CNT
+};
+
+/*
+ * Utilization clamp of a RUNNABLE task: the effective value and the rq
+ * bucket it has been accounted in, see uclamp_rq_inc().
+ */
+struct uclamp_se {
+	unsigned int			value;
+	unsigned int			bucket_id;
+};
+#endif /* CONFIG_UCLAMP_TASK */
+
 union rcu_special {
 	struct {
 		u8			blocked;
@@ -513,6 +530,7 @@ struct task_struct {
 
 	int				prio;
 	int				static_prio;
+	int				latency_nice;
 	int				normal_prio;
 	unsigned int			rt_priority;
 
@@ -524,6 +542,18 @@ struct task_struct {
 #endif
 	struct sched_dl_entity		dl;
 
+#ifdef CONFIG_SCHED_CORE
+	/* Tasks only share an SMT core with tasks of the same cookie: */
+	unsigned long			core_cookie;
+#endif
+
+#ifdef CONFIG_UCLAMP_TASK
+	/* Clamp values requested through sched_setattr(): */
+	unsigned int			uclamp_req[UCLAMP_CNT];
+	/* Effective clamp values while RUNNABLE: */
+	struct uclamp_se		uclamp[UCLAMP_CNT];
+#endif
+
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	/* List of struct preempt_notifier: */
 	struct hlist_head		preempt_notifiers;
@@ -930,6 +960,12 @@ struct task_struct {
 	unsigned long			numa_faults_locality[3];
 
 	unsigned long			numa_pages_migrated;
+
+	/*
+	 * Pages moved to each node by accessed-bit sampling, allocated on
+	 * the first sampling migration:
+	 */
+	unsigned long			*numa_sampled_migrated;
 #endif /* CONFIG_NUMA_BALANCING */
 
 	struct tlbflush_unmap_batch	tlb_ubc;
@@ -71,8 +71,25 @@ struct sched_domain_shared {
 	atomic_t	ref;
 	atomic_t	nr_busy_cpus;
 	int		has_idle_cores;
+
+	/*
+	 * Idle CPUs and CPUs of fully idle cores of the LLC, as two cpumasks
+	 * allocated past the end of the structure.  Only hints for
+	 * select_idle_sibling(): candidates are rechecked before use.
+	 */
+	unsigned long	idle_masks[0];
 };
 
+static inline struct cpumask *sds_idle_cpus(struct sched_domain_shared *sds)
+{
+	return to_cpumask(sds->idle_masks);
+}
+
+static inline struct cpumask *sds_idle_cores(struct sched_domain_shared *sds)
+{
+	return to_cpumask(sds->idle_masks + BITS_TO_LONGS(nr_cpumask_bits));
+}
+
 struct sched_domain {
 	/* These fields must be setup */
 	struct sched_domain *parent;	/* top domain must be null terminated */
@@ -116,6 +133,11 @@ struct sched_domain {
 	unsigned int lb_nobusyg[CPU_MAX_IDLE_TYPES];
 	unsigned int lb_nobusyq[CPU_MAX_IDLE_TYPES];
 
+	/* update_sd_lb_stats() group statistics cache */
+	unsigned int lb_sgs_hit;
+	unsigned int lb_sgs_miss;
+	u64 lb_stats_time;
+
 	/* Active load balancing */
 	unsigned int alb_count;
 	unsigned int alb_failed;
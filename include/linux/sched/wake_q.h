@@ -50,4 +50,12 @@ extern void wake_q_add(struct wake_q_head *head,
 		       struct task_struct *task);
 extern void wake_up_q(struct wake_q_head *head);
 
+#ifdef CONFIG_SMP
+extern bool ttwu_batch_begin(void);
+extern void ttwu_batch_end(bool batch);
+#else
+static inline bool ttwu_batch_begin(void) { return false; }
+static inline void ttwu_batch_end(bool batch) { }
+#endif
+
 #endif /* _LINUX_SCHED_WAKE_Q_H */
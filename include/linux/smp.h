@@ -73,6 +73,19 @@ extern void smp_send_stop(void);
  */
 extern void smp_send_reschedule(int cpu);
 
+/*
+ * sends a 'reschedule' event to a set of CPUs, arches which can multicast
+ * an IPI override this:
+ */
+#ifndef smp_send_reschedule_mask
+static inline void smp_send_reschedule_mask(const struct cpumask *mask)
+{
+	int cpu;
+
+	for_each_cpu(cpu, mask)
+		smp_send_reschedule(cpu);
+}
+#endif
 
 /*
  * Prepare machine for booting other CPUs.
@@ -95,6 +108,8 @@ extern void smp_cpus_done(unsigned int max_cpus);
 int smp_call_function(smp_call_func_t func, void *info, int wait);
 void smp_call_function_many(const struct cpumask *mask,
 			    smp_call_func_t func, void *info, bool wait);
+void smp_call_function_broadcast(const struct cpumask *mask,
+				 smp_call_func_t func, void *info, bool wait);
 
 int smp_call_function_any(const struct cpumask *mask,
 			  smp_call_func_t func, void *info, int wait);
@@ -143,9 +158,12 @@ static inline int up_smp_call_function(smp_call_func_t func, void *info)
 			(up_smp_call_function(func, info))
 
 static inline void smp_send_reschedule(int cpu) { }
+static inline void smp_send_reschedule_mask(const struct cpumask *mask) { }
 #define smp_prepare_boot_cpu()			do {} while (0)
 #define smp_call_function_many(mask, func, info, wait) \
 			(up_smp_call_function(func, info))
+#define smp_call_function_broadcast(mask, func, info, wait) \
+			(up_smp_call_function(func, info))
 static inline void call_function_init(void) { }
 
 static inline int
@@ -51,8 +51,16 @@ struct timer_list {
  * Note: The irq disabled callback execution is a special case for
  * workqueue locking issues. It's not meant for executing random crap
  * with interrupts disabled. Abuse is monitored!
+ *
+ * A batchable timer tolerates being expired a little late: with
+ * CONFIG_TIMER_BATCH and batching enabled, its expiry is rounded up to a
+ * slack window so that such timers expire together, and when more of them
+ * are due than the per-run batch limit the rest are expired by a per-node
+ * kthread instead of the timer softirq. Unless pinned, its callback must
+ * thus not depend on running on the CPU the timer was armed on.
  */
-#define TIMER_CPUMASK		0x0003FFFF
+#define TIMER_CPUMASK		0x0001FFFF
+#define TIMER_BATCHABLE		0x00020000
 #define TIMER_MIGRATING		0x00040000
 #define TIMER_BASEMASK		(TIMER_CPUMASK | TIMER_MIGRATING)
 #define TIMER_DEFERRABLE	0x00080000
@@ -61,7 +69,8 @@ struct timer_list {
 #define TIMER_ARRAYSHIFT	22
 #define TIMER_ARRAYMASK		0xFFC00000
 
-#define TIMER_TRACE_FLAGMASK	(TIMER_MIGRATING | TIMER_DEFERRABLE | TIMER_PINNED | TIMER_IRQSAFE)
+#define TIMER_TRACE_FLAGMASK	(TIMER_MIGRATING | TIMER_DEFERRABLE | TIMER_PINNED | TIMER_IRQSAFE | \
+				 TIMER_BATCHABLE)
 
 #define __TIMER_INITIALIZER(_function, _expires, _data, _flags) { \
 		.entry = { .next = TIMER_ENTRY_STATIC },	\
@@ -159,6 +168,8 @@ static inline void init_timer_on_stack_key(struct timer_list *timer,
 	__setup_timer((timer), (fn), (data), TIMER_DEFERRABLE)
 #define setup_pinned_deferrable_timer(timer, fn, data)			\
 	__setup_timer((timer), (fn), (data), TIMER_DEFERRABLE | TIMER_PINNED)
+#define setup_batchable_timer(timer, fn, data)				\
+	__setup_timer((timer), (fn), (data), TIMER_BATCHABLE)
 #define setup_timer_on_stack(timer, fn, data)				\
 	__setup_timer_on_stack((timer), (fn), (data), 0)
 #define setup_pinned_timer_on_stack(timer, fn, data)			\
@@ -159,6 +159,20 @@ DEFINE_EVENT(softirq, softirq_raise,
 	TP_ARGS(vec_nr)
 );
 
+/**
+ * softirq_defer - called when a softirq vector is left to ksoftirqd
+ * @vec_nr:  softirq vector number
+ *
+ * The vector used up its time budget; until ksoftirqd has run it, it is
+ * no longer processed on irq exit and local_bh_enable().
+ */
+DEFINE_EVENT(softirq, softirq_defer,
+
+	TP_PROTO(unsigned int vec_nr),
+
+	TP_ARGS(vec_nr)
+);
+
 #endif /*  _TRACE_IRQ_H */
 
 /* This part must be outside protection */
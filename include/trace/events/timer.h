@@ -41,7 +41,8 @@ DEFINE_EVENT(timer_class, timer_init,
 		{  TIMER_MIGRATING,	"M" },		\
 		{  TIMER_DEFERRABLE,	"D" },		\
 		{  TIMER_PINNED,	"P" },		\
-		{  TIMER_IRQSAFE,	"I" })
+		{  TIMER_IRQSAFE,	"I" },		\
+		{  TIMER_BATCHABLE,	"B" })
 
 /**
  * timer_start - called when the timer is started
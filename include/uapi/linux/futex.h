@@ -20,6 +20,7 @@
 #define FUTEX_WAKE_BITSET	10
 #define FUTEX_WAIT_REQUEUE_PI	11
 #define FUTEX_CMP_REQUEUE_PI	12
+#define FUTEX_WAIT_MULTIPLE	13
 
 #define FUTEX_PRIVATE_FLAG	128
 #define FUTEX_CLOCK_REALTIME	256
@@ -40,6 +41,25 @@
 #define FUTEX_CMP_REQUEUE_PI_PRIVATE	(FUTEX_CMP_REQUEUE_PI | \
 					 FUTEX_PRIVATE_FLAG)
 
+/*
+ * FUTEX_WAIT_MULTIPLE waits on several futexes at once: uaddr points to an
+ * array of val futex_wait_block entries, and the calling thread blocks
+ * until one of the futexes is woken, or returns -EWOULDBLOCK right away if
+ * any of them does not contain its expected value. The optional timeout
+ * is absolute, as for FUTEX_WAIT_BITSET. On wakeup the index of the futex
+ * which was woken is returned.
+ *
+ * The only flag allowed in a futex_wait_block is FUTEX_PRIVATE_FLAG; the
+ * one of the operation itself is ignored.
+ */
+struct futex_wait_block {
+	__u64	uaddr;
+	__u32	val;
+	__u32	flags;
+};
+
+#define FUTEX_WAIT_MULTIPLE_MAX	128
+
 /*
  * Support for robust futexes: the kernel cleans up held futexes at
  * thread exit time.
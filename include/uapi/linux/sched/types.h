@@ -8,6 +8,8 @@ struct sched_param {
 };
 
 #define SCHED_ATTR_SIZE_VER0	48	/* sizeof first published struct */
+#define SCHED_ATTR_SIZE_VER1	56	/* add: util_{min,max} */
+#define SCHED_ATTR_SIZE_VER2	60	/* add: latency_nice */
 
 /*
  * Extended scheduling parameters data structure.
@@ -45,6 +47,24 @@ struct sched_param {
  *  @sched_runtime	representative of the task's runtime
  *  @sched_period	representative of the task's period
  *
+ * Task utilization attributes, for frequency selection:
+ *
+ *  @sched_util_min	task's min utilization, [0 ... 1024]
+ *  @sched_util_max	task's max utilization, [0 ... 1024]
+ *
+ * The utilization of a CPU used to pick its frequency is clamped between
+ * the highest sched_util_min and the highest sched_util_max of the tasks
+ * RUNNABLE on it.  They are only applied with SCHED_FLAG_UTIL_CLAMP_MIN
+ * and SCHED_FLAG_UTIL_CLAMP_MAX respectively.
+ *
+ * Independently of the policy, SCHED_NORMAL/BATCH tasks can give a hint
+ * about how much they care about wakeup latency:
+ *
+ *  @sched_latency_nice	task's latency nice value, [-20 ... 19]; lower
+ *			values ask for faster wakeups, higher values
+ *			let the task be woken more cheaply.  Only
+ *			applied with SCHED_FLAG_LATENCY_NICE.
+ *
  * Given this task model, there are a multiplicity of scheduling algorithms
  * and policies, that can be used to ensure all the tasks will make their
  * timing constraints.
@@ -69,6 +89,13 @@ struct sched_attr {
 	u64 sched_runtime;
 	u64 sched_deadline;
 	u64 sched_period;
+
+	/* Utilization hints */
+	u32 sched_util_min;
+	u32 sched_util_max;
+
+	/* SCHED_FLAG_LATENCY_NICE */
+	s32 sched_latency_nice;
 };
 
 #endif /* _UAPI_LINUX_SCHED_TYPES_H */
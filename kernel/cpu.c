@@ -10,6 +10,7 @@
 #include <linux/sched/signal.h>
 #include <linux/sched/hotplug.h>
 #include <linux/sched/task.h>
+#include <linux/sched/clock.h>
 #include <linux/unistd.h>
 #include <linux/cpu.h>
 #include <linux/oom.h>
@@ -113,6 +114,38 @@ static struct cpuhp_step *cpuhp_get_step(enum cpuhp_state state)
 	return sp + state;
 }
 
+/**
+ * cpuhp_boot_stat - Per state callback time while bringing up the
+ * secondary CPUs at boot
+ * @total_ns:	Time spent in the callbacks of the state, summed over CPUs
+ * @max_ns:	Longest single invocation
+ * @count:	Number of invocations
+ */
+struct cpuhp_boot_stat {
+	atomic64_t		total_ns;
+	atomic64_t		max_ns;
+	atomic_t		count;
+};
+
+/* Indexed by state, only allocated for the duration of the boot bringup */
+static struct cpuhp_boot_stat *cpuhp_boot_stats;
+
+static void cpuhp_boot_stat_add(struct cpuhp_boot_stat *bs, u64 delta)
+{
+	u64 max = atomic64_read(&bs->max_ns);
+
+	atomic64_add(delta, &bs->total_ns);
+	atomic_inc(&bs->count);
+
+	while (delta > max) {
+		u64 old = atomic64_cmpxchg(&bs->max_ns, max, delta);
+
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
 /**
  * cpuhp_invoke_callback _ Invoke the callbacks for a given state
  * @cpu:	The cpu for which the callback should be invoked
@@ -121,8 +154,8 @@ static struct cpuhp_step *cpuhp_get_step(enum cpuhp_state state)
  *
  * Called from cpu hotplug and from the state register machinery.
  */
-static int cpuhp_invoke_callback(unsigned int cpu, enum cpuhp_state state,
-				 bool bringup, struct hlist_node *node)
+static int __cpuhp_invoke_callback(unsigned int cpu, enum cpuhp_state state,
+				   bool bringup, struct hlist_node *node)
 {
 	struct cpuhp_cpu_state *st = per_cpu_ptr(&cpuhp_state, cpu);
 	struct cpuhp_step *step = cpuhp_get_step(state);
@@ -176,6 +209,22 @@ err:
 	return ret;
 }
 
+static int cpuhp_invoke_callback(unsigned int cpu, enum cpuhp_state state,
+				 bool bringup, struct hlist_node *node)
+{
+	struct cpuhp_boot_stat *stats = READ_ONCE(cpuhp_boot_stats);
+	u64 start;
+	int ret;
+
+	if (likely(!stats))
+		return __cpuhp_invoke_callback(cpu, state, bringup, node);
+
+	start = local_clock();
+	ret = __cpuhp_invoke_callback(cpu, state, bringup, node);
+	cpuhp_boot_stat_add(&stats[state], local_clock() - start);
+	return ret;
+}
+
 #ifdef CONFIG_SMP
 /* Serializes the updates to cpu_online_mask, cpu_present_mask */
 static DEFINE_MUTEX(cpu_add_remove_lock);
@@ -981,6 +1030,134 @@ int cpu_up(unsigned int cpu)
 }
 EXPORT_SYMBOL_GPL(cpu_up);
 
+/*
+ * With "cpuhp.parallel" the secondary CPUs are first brought up to
+ * CPUHP_AP_ONLINE_IDLE one at a time, which covers the BP states, the
+ * low level bringup and the starting states. The online states, which
+ * every CPU runs in its own hotplug thread, are then kicked off on all of
+ * them at once.
+ */
+static bool cpuhp_parallel_bringup __initdata;
+
+static int __init cpuhp_parallel_setup(char *str)
+{
+	if (!str)
+		cpuhp_parallel_bringup = true;
+	else if (kstrtobool(str, &cpuhp_parallel_bringup))
+		return -EINVAL;
+	return 0;
+}
+early_param("cpuhp.parallel", cpuhp_parallel_setup);
+
+static struct cpumask cpuhp_bringup_mask __initdata;
+
+static void __init cpuhp_online_parallel(void)
+{
+	struct cpuhp_cpu_state *st;
+	unsigned int cpu;
+
+	cpu_maps_update_begin();
+	cpu_hotplug_begin();
+
+	for_each_online_cpu(cpu) {
+		st = per_cpu_ptr(&cpuhp_state, cpu);
+		if (st->state != CPUHP_AP_ONLINE_IDLE)
+			continue;
+
+		st->target = CPUHP_ONLINE;
+		__cpuhp_kick_ap_work(st);
+		cpumask_set_cpu(cpu, &cpuhp_bringup_mask);
+	}
+
+	for_each_cpu(cpu, &cpuhp_bringup_mask) {
+		st = per_cpu_ptr(&cpuhp_state, cpu);
+		wait_for_completion(&st->done);
+		/* The AP side has rolled back to CPUHP_AP_ONLINE_IDLE */
+		if (st->result)
+			pr_warn("CPU%u failed to come online: %d\n", cpu,
+				st->result);
+	}
+
+	cpu_hotplug_done();
+	cpu_maps_update_done();
+}
+
+static void __init cpuhp_boot_report(struct cpuhp_boot_stat *stats)
+{
+	enum cpuhp_state state;
+	int i;
+
+	pr_info("Slowest CPU bringup states (us, all CPUs):\n");
+	for (i = 0; i < 10; i++) {
+		enum cpuhp_state worst = CPUHP_OFFLINE;
+		u64 worst_ns = 0;
+
+		for (state = CPUHP_OFFLINE; state <= CPUHP_ONLINE; state++) {
+			u64 ns = atomic64_read(&stats[state].total_ns);
+
+			if (ns > worst_ns && cpuhp_get_step(state)->name) {
+				worst = state;
+				worst_ns = ns;
+			}
+		}
+		if (!worst_ns)
+			break;
+
+		pr_info("  %-32s %5d calls %10llu total %8llu max\n",
+			cpuhp_get_step(worst)->name,
+			atomic_read(&stats[worst].count),
+			div_u64(worst_ns, NSEC_PER_USEC),
+			div_u64(atomic64_read(&stats[worst].max_ns),
+				NSEC_PER_USEC));
+		/* don't pick it again */
+		atomic64_set(&stats[worst].total_ns, 0);
+	}
+}
+
+/**
+ * bringup_nonboot_cpus - Bring up the secondary CPUs at boot
+ * @setup_max_cpus:	Maximum number of CPUs to have online
+ *
+ * Also reports which hotplug states the bringup spent most time in. The
+ * numbers of nested states (the AP starting states run within the BP's
+ * cpu:bringup) are included in the outer one as well.
+ */
+void __init bringup_nonboot_cpus(unsigned int setup_max_cpus)
+{
+	enum cpuhp_state target;
+	struct cpuhp_boot_stat *stats;
+	unsigned int cpu;
+	u64 start;
+
+	stats = kcalloc(CPUHP_ONLINE + 1, sizeof(*stats), GFP_KERNEL);
+	WRITE_ONCE(cpuhp_boot_stats, stats);
+
+	target = cpuhp_parallel_bringup ? CPUHP_AP_ONLINE_IDLE : CPUHP_ONLINE;
+
+	start = local_clock();
+	for_each_present_cpu(cpu) {
+		if (num_online_cpus() >= setup_max_cpus)
+			break;
+		if (!cpu_online(cpu))
+			do_cpu_up(cpu, target);
+	}
+
+	if (cpuhp_parallel_bringup) {
+		pr_info("Secondary CPUs reached %s after %llu ms\n",
+			cpuhp_get_step(target)->name,
+			div_u64(local_clock() - start, NSEC_PER_MSEC));
+		cpuhp_online_parallel();
+	}
+	pr_info("Secondary CPUs online after %llu ms\n",
+		div_u64(local_clock() - start, NSEC_PER_MSEC));
+
+	WRITE_ONCE(cpuhp_boot_stats, NULL);
+	if (stats) {
+		cpuhp_boot_report(stats);
+		kfree(stats);
+	}
+}
+
 #ifdef CONFIG_PM_SLEEP_SMP
 static cpumask_var_t frozen_cpus;
 
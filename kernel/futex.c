@@ -277,6 +277,92 @@ static struct {
 #define futex_queues   (__futex_data.queues)
 #define futex_hashsize (__futex_data.hashsize)
 
+/*
+ * Private futexes can only ever match within one mm, so instead of the
+ * global table they are hashed into a table of their own mm: unrelated
+ * processes don't collide on the bucket locks anymore and the buckets are
+ * allocated on the node the process runs on.
+ *
+ * The table is set up by get_futex_key() on the first private futex
+ * operation of an mm with more than one user, sized after the number of
+ * threads or CPUs, whichever is larger.  As long as an mm has a single
+ * user, no one else can be waiting on its private futexes and the global
+ * table is used; once set up, the choice is never revisited, so that
+ * waiters and wakers always agree on the bucket.  If the allocation fails
+ * the mm sticks with the global table.
+ */
+struct futex_private_hash {
+	unsigned long			hashmask;
+	struct futex_hash_bucket	queues[];
+};
+
+/* mm->futex_hash of an mm which failed to allocate its table */
+#define FUTEX_PRIVATE_HASH_GLOBAL	((struct futex_private_hash *)1UL)
+
+static bool futex_private_hash_enabled __read_mostly = true;
+
+static int __init setup_futex_private_hash(char *str)
+{
+	return !kstrtobool(str, &futex_private_hash_enabled);
+}
+__setup("futex_private_hash=", setup_futex_private_hash);
+
+void futex_mm_init(struct mm_struct *mm)
+{
+	mm->futex_hash = NULL;
+}
+
+void futex_mm_free(struct mm_struct *mm)
+{
+	if (mm->futex_hash != FUTEX_PRIVATE_HASH_GLOBAL)
+		kvfree(mm->futex_hash);
+	mm->futex_hash = NULL;
+}
+
+static void futex_private_hash_alloc(struct mm_struct *mm)
+{
+	struct futex_private_hash *fph;
+	unsigned long i, size;
+
+	size = max_t(unsigned long, get_nr_threads(current),
+		     num_online_cpus());
+	size = clamp(roundup_pow_of_two(4 * size), 16UL, futex_hashsize);
+
+	fph = kvzalloc_node(sizeof(*fph) + size * sizeof(fph->queues[0]),
+			    GFP_KERNEL, numa_node_id());
+	if (!fph) {
+		cmpxchg(&mm->futex_hash, NULL, FUTEX_PRIVATE_HASH_GLOBAL);
+		return;
+	}
+
+	fph->hashmask = size - 1;
+	for (i = 0; i < size; i++) {
+		atomic_set(&fph->queues[i].waiters, 0);
+		plist_head_init(&fph->queues[i].chain);
+		spin_lock_init(&fph->queues[i].lock);
+	}
+
+	/* lost the race against another thread */
+	if (cmpxchg(&mm->futex_hash, NULL, fph))
+		kvfree(fph);
+}
+
+/*
+ * Called for private keys of @mm from get_futex_key(), which may sleep,
+ * such that hash_futex() never has to allocate.
+ */
+static inline void futex_private_hash_prepare(struct mm_struct *mm)
+{
+	if (likely(READ_ONCE(mm->futex_hash)) || !futex_private_hash_enabled)
+		return;
+
+	/* a single user can't race with waiters on the global table */
+	if (atomic_read(&mm->mm_users) == 1)
+		return;
+
+	futex_private_hash_alloc(mm);
+}
+
 
 /*
  * Fault injections for futexes.
@@ -384,17 +470,27 @@ static inline int hb_waiters_pending(struct futex_hash_bucket *hb)
 }
 
 /**
- * hash_futex - Return the hash bucket in the global hash
+ * hash_futex - Return the hash bucket of a futex key
  * @key:	Pointer to the futex key for which the hash is calculated
  *
  * We hash on the keys returned from get_futex_key (see below) and return the
- * corresponding hash bucket in the global hash.
+ * corresponding hash bucket in the private hash of the mm for private keys,
+ * if it has one, or in the global hash otherwise.
  */
 static struct futex_hash_bucket *hash_futex(union futex_key *key)
 {
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
+
+	if (!(key->both.offset & (FUT_OFF_INODE|FUT_OFF_MMSHARED))) {
+		struct futex_private_hash *fph;
+
+		fph = READ_ONCE(key->private.mm->futex_hash);
+		if (fph && fph != FUTEX_PRIVATE_HASH_GLOBAL)
+			return &fph->queues[hash & fph->hashmask];
+	}
+
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
@@ -529,6 +625,7 @@ get_futex_key(u32 __user *uaddr, int fshared, union futex_key *key, int rw)
 	if (!fshared) {
 		key->private.mm = mm;
 		key->private.address = address;
+		futex_private_hash_prepare(mm);
 		get_futex_key_refs(key);  /* implies smp_mb(); (B) */
 		return 0;
 	}
@@ -2574,6 +2671,217 @@ static long futex_wait_restart(struct restart_block *restart)
 				restart->futex.val, tp, restart->futex.bitset);
 }
 
+/**
+ * unqueue_multiple() - Remove the futexes of a FUTEX_WAIT_MULTIPLE
+ * @qs:		the array of futex_q
+ * @count:	number of entries of @qs which have been queued
+ *
+ * Return: the index of the first futex which has been woken, or -1 if
+ * none has been.
+ */
+static int unqueue_multiple(struct futex_q *qs, int count)
+{
+	int ret = -1;
+	int i;
+
+	/* unqueue_me() drops the key refs */
+	for (i = 0; i < count; i++) {
+		if (!unqueue_me(&qs[i]) && ret < 0)
+			ret = i;
+	}
+	return ret;
+}
+
+/**
+ * futex_wait_multiple_setup() - Prepare to wait on several futexes
+ * @qs:		the futex_q of each futex
+ * @wb:		the futexes and their expected values
+ * @count:	number of entries of @qs and @wb
+ * @woken:	storage for the index of a futex woken during the setup
+ *
+ * Like futex_wait_setup(), but queues all futexes, one after the other,
+ * with the task state already set. A futex may therefore be woken before
+ * the last one is queued, in which case the wakeup makes the following
+ * schedule() a no-op.
+ *
+ * Return:
+ *  0 - all futexes contain their values and are queued;
+ *  1 - a futex was found not to contain its value, but an earlier one had
+ *      been woken in the meantime: its index is stored in @woken;
+ * <0 - -EFAULT, or -EWOULDBLOCK if a futex does not contain its value;
+ *      nothing is queued and no key reference is held
+ */
+static int futex_wait_multiple_setup(struct futex_q *qs,
+				     struct futex_wait_block *wb, int count,
+				     int *woken)
+{
+	struct futex_hash_bucket *hb;
+	u32 __user *uaddr;
+	int i, j, ret;
+	u32 uval;
+
+retry:
+	for (i = 0; i < count; i++) {
+		uaddr = u64_to_user_ptr(wb[i].uaddr);
+		ret = get_futex_key(uaddr, !(wb[i].flags & FUTEX_PRIVATE_FLAG),
+				    &qs[i].key, VERIFY_READ);
+		if (unlikely(ret)) {
+			while (--i >= 0)
+				put_futex_key(&qs[i].key);
+			return ret;
+		}
+	}
+
+	/* See futex_wait_queue_me() */
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	for (i = 0; i < count; i++) {
+		uaddr = u64_to_user_ptr(wb[i].uaddr);
+
+		hb = queue_lock(&qs[i]);
+		ret = get_futex_value_locked(&uval, uaddr);
+		if (!ret && uval == wb[i].val) {
+			queue_me(&qs[i], hb);
+			continue;
+		}
+
+		queue_unlock(hb);
+		__set_current_state(TASK_RUNNING);
+
+		*woken = unqueue_multiple(qs, i);
+		for (j = i; j < count; j++)
+			put_futex_key(&qs[j].key);
+		if (*woken >= 0)
+			return 1;
+		if (!ret)
+			return -EWOULDBLOCK;
+
+		ret = get_user(uval, uaddr);
+		if (ret)
+			return ret;
+		goto retry;
+	}
+
+	return 0;
+}
+
+/**
+ * futex_sleep_multiple() - Wait for a wakeup, timeout, or signal
+ * @qs:		the queued futex_q
+ * @count:	number of entries of @qs
+ * @timeout:	the prepared hrtimer_sleeper, or null for no timeout
+ */
+static void futex_sleep_multiple(struct futex_q *qs, int count,
+				 struct hrtimer_sleeper *timeout)
+{
+	int i;
+
+	if (timeout)
+		hrtimer_start_expires(&timeout->timer, HRTIMER_MODE_ABS);
+
+	/* don't bother sleeping if a futex has been woken already */
+	for (i = 0; i < count; i++) {
+		if (plist_node_empty(&qs[i].list))
+			goto out;
+	}
+
+	if (!timeout || timeout->task)
+		freezable_schedule();
+out:
+	__set_current_state(TASK_RUNNING);
+}
+
+/**
+ * futex_wait_multiple() - Wait on several futexes at once
+ * @uaddr:	the user space array of struct futex_wait_block
+ * @flags:	futex flags of the operation (only FLAGS_CLOCKRT is used)
+ * @count:	number of entries of the array
+ * @abs_time:	absolute timeout, or NULL for none
+ *
+ * The futexes are queued as for futex_wait(), each with its own futex_q,
+ * and a wakeup of any of them ends the wait. Wakeups of other futexes
+ * which race with the one reported are consumed.
+ *
+ * Return: the index of the futex which was woken, or -EWOULDBLOCK,
+ * -ETIMEDOUT, -ERESTARTSYS or another error.
+ */
+static int futex_wait_multiple(u32 __user *uaddr, unsigned int flags,
+			       u32 count, ktime_t *abs_time)
+{
+	struct hrtimer_sleeper timeout, *to = NULL;
+	struct futex_wait_block *wb;
+	struct futex_q *qs;
+	int i, ret, woken = -1;
+
+	if (!count || count > FUTEX_WAIT_MULTIPLE_MAX)
+		return -EINVAL;
+
+	wb = kmalloc_array(count, sizeof(*wb), GFP_KERNEL);
+	qs = kmalloc_array(count, sizeof(*qs), GFP_KERNEL);
+	if (!wb || !qs) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	if (copy_from_user(wb, uaddr, count * sizeof(*wb))) {
+		ret = -EFAULT;
+		goto out_free;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (wb[i].flags & ~FUTEX_PRIVATE_FLAG) {
+			ret = -EINVAL;
+			goto out_free;
+		}
+		qs[i] = futex_q_init;
+	}
+
+	if (abs_time) {
+		to = &timeout;
+
+		hrtimer_init_on_stack(&to->timer, (flags & FLAGS_CLOCKRT) ?
+				      CLOCK_REALTIME : CLOCK_MONOTONIC,
+				      HRTIMER_MODE_ABS);
+		hrtimer_init_sleeper(to, current);
+		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
+					     current->timer_slack_ns);
+	}
+
+retry:
+	ret = futex_wait_multiple_setup(qs, wb, count, &woken);
+	if (ret) {
+		if (ret > 0)
+			ret = woken;
+		goto out;
+	}
+
+	futex_sleep_multiple(qs, count, to);
+
+	ret = unqueue_multiple(qs, count);
+	if (ret >= 0)
+		goto out;
+	ret = -ETIMEDOUT;
+	if (to && !to->task)
+		goto out;
+
+	/* As in futex_wait(), this may be a spurious wakeup */
+	if (!signal_pending(current))
+		goto retry;
+
+	/* the timeout is absolute, so the syscall can simply be restarted */
+	ret = -ERESTARTSYS;
+
+out:
+	if (to) {
+		hrtimer_cancel(&to->timer);
+		destroy_hrtimer_on_stack(&to->timer);
+	}
+out_free:
+	kfree(qs);
+	kfree(wb);
+	return ret;
+}
+
 
 /*
  * Userspace tried a 0 -> TID atomic transition of the futex value
@@ -3372,7 +3680,7 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 	if (op & FUTEX_CLOCK_REALTIME) {
 		flags |= FLAGS_CLOCKRT;
 		if (cmd != FUTEX_WAIT && cmd != FUTEX_WAIT_BITSET && \
-		    cmd != FUTEX_WAIT_REQUEUE_PI)
+		    cmd != FUTEX_WAIT_MULTIPLE && cmd != FUTEX_WAIT_REQUEUE_PI)
 			return -ENOSYS;
 	}
 
@@ -3391,6 +3699,8 @@ long do_futex(u32 __user *uaddr, int op, u32 val, ktime_t *timeout,
 		val3 = FUTEX_BITSET_MATCH_ANY;
 	case FUTEX_WAIT_BITSET:
 		return futex_wait(uaddr, flags, val, timeout, val3);
+	case FUTEX_WAIT_MULTIPLE:
+		return futex_wait_multiple(uaddr, flags, val, timeout);
 	case FUTEX_WAKE:
 		val3 = FUTEX_BITSET_MATCH_ANY;
 	case FUTEX_WAKE_BITSET:
@@ -3428,7 +3738,7 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 	int cmd = op & FUTEX_CMD_MASK;
 
 	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
-		      cmd == FUTEX_WAIT_BITSET ||
+		      cmd == FUTEX_WAIT_BITSET || cmd == FUTEX_WAIT_MULTIPLE ||
 		      cmd == FUTEX_WAIT_REQUEUE_PI)) {
 		if (unlikely(should_fail_futex(!(op & FUTEX_PRIVATE_FLAG))))
 			return -EFAULT;
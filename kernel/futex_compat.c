@@ -181,7 +181,7 @@ COMPAT_SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 	int cmd = op & FUTEX_CMD_MASK;
 
 	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
-		      cmd == FUTEX_WAIT_BITSET ||
+		      cmd == FUTEX_WAIT_BITSET || cmd == FUTEX_WAIT_MULTIPLE ||
 		      cmd == FUTEX_WAIT_REQUEUE_PI)) {
 		if (compat_get_timespec(&ts, utime))
 			return -EFAULT;
@@ -0,0 +1,226 @@
+/*
+ * Lightweight lock contention profiling
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * CONFIG_LOCK_STAT gives per lock class contention numbers, but needs full
+ * lockdep. This is a much cheaper alternative meant to be left enabled on
+ * production systems: the slowpaths of qspinlock, mutex, rwsem and rtmutex
+ * report how long they waited, and the wait time is accounted to the call
+ * site of the lock operation in a per-cpu hash table, along with a log2
+ * histogram of the individual waits. When profiling is off the only cost
+ * is a static branch in each slowpath.
+ *
+ * <debugfs>/lock_contention/
+ *   enable	- write 1/0 to turn profiling on/off (or boot with
+ *		  "lock_contention")
+ *   top	- the call sites with the largest total wait time
+ *   nr_top	- number of call sites listed in "top" (default 32)
+ *   reset	- write anything to clear the tables
+ *
+ * The call site is the first return address outside of the locking and
+ * scheduler text, which is why this depends on frame pointers.
+ */
+#include <linux/debug_stats.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/kallsyms.h>
+#include <linux/sched/debug.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
+
+#include "lock_contention.h"
+
+#define LC_HASH_BITS		9
+
+/* wait time histogram, see debug_stats_log2_bucket() */
+#define LC_HIST_BUCKETS		16
+
+/* ->cs.tag is the lock_contention_type */
+struct lc_entry {
+	struct callsite_entry	cs;
+	unsigned int		hist[LC_HIST_BUCKETS];
+};
+
+static const char * const lc_type_names[LC_NR_TYPES] = {
+	[LC_SPINLOCK]	 = "spinlock",
+	[LC_MUTEX]	 = "mutex",
+	[LC_RWSEM_READ]	 = "rwsem-r",
+	[LC_RWSEM_WRITE] = "rwsem-w",
+	[LC_RTMUTEX]	 = "rtmutex",
+};
+
+DEFINE_STATIC_KEY_FALSE(lock_contention_key);
+
+static void lc_merge(struct callsite_entry *dst,
+		     const struct callsite_entry *src);
+
+static struct callsite_table lc_table = {
+	.entry_size	= sizeof(struct lc_entry),
+	.hash_bits	= LC_HASH_BITS,
+	.merge		= lc_merge,
+};
+
+static DEFINE_MUTEX(lc_mutex);
+static unsigned int lc_nr_top = 32;
+static bool lc_boot_enable;
+
+/*
+ * Walk up the frame pointers for the first return address that is not
+ * part of a lock implementation. Frame 0 is always the slowpath calling
+ * us, so start at 1.
+ */
+#define LC_TRY_FRAME(n)							\
+do {									\
+	unsigned long __ip = (unsigned long)__builtin_return_address(n); \
+									\
+	if (!__ip || !in_sched_functions(__ip))				\
+		return __ip;						\
+} while (0)
+
+static __always_inline unsigned long lc_caller(void)
+{
+	LC_TRY_FRAME(1);
+	LC_TRY_FRAME(2);
+	LC_TRY_FRAME(3);
+	LC_TRY_FRAME(4);
+	LC_TRY_FRAME(5);
+	LC_TRY_FRAME(6);
+
+	return (unsigned long)__builtin_return_address(1);
+}
+
+noinline void __lock_contention_end(u64 start, enum lock_contention_type type)
+{
+	u64 delta = local_clock() - start;
+	unsigned long ip, flags;
+	struct callsite_entry *cs;
+	struct lc_entry *e;
+
+	/* NMIs may interrupt the update below; don't bother */
+	if (in_nmi())
+		return;
+
+	ip = lc_caller();
+
+	local_irq_save(flags);
+	cs = callsite_table_lookup(&lc_table, ip, type);
+	if (!cs)
+		goto out;
+	e = container_of(cs, struct lc_entry, cs);
+
+	callsite_entry_add(&e->cs, delta);
+	e->hist[debug_stats_log2_bucket(delta, LC_HIST_BUCKETS)]++;
+out:
+	local_irq_restore(flags);
+}
+
+static void lc_merge(struct callsite_entry *dst,
+		     const struct callsite_entry *src)
+{
+	struct lc_entry *d = container_of(dst, struct lc_entry, cs);
+	const struct lc_entry *s = container_of(src, struct lc_entry, cs);
+	int b;
+
+	for (b = 0; b < LC_HIST_BUCKETS; b++)
+		d->hist[b] += s->hist[b];
+}
+
+static int lc_top_show(struct seq_file *m, void *v)
+{
+	struct lc_entry *merged;
+	unsigned long dropped;
+	int i, nr;
+
+	merged = callsite_table_alloc_merged(&lc_table);
+	if (!merged)
+		return -ENOMEM;
+
+	mutex_lock(&lc_mutex);
+	nr = callsite_table_merge(&lc_table, merged, &dropped);
+
+	seq_printf(m, "# enabled: %d  call sites: %d  dropped: %lu\n",
+		   static_key_enabled(&lock_contention_key), nr, dropped);
+	seq_printf(m, "# %-8s %10s %14s %10s %10s  %s\n", "type", "count",
+		   "total(us)", "avg(ns)", "max(us)", "call site");
+
+	for (i = 0; i < min_t(int, nr, lc_nr_top); i++) {
+		struct lc_entry *e = &merged[i];
+
+		seq_printf(m, "  %-8s %10llu %14llu %10llu %10llu  %pS\n",
+			   lc_type_names[e->cs.tag], e->cs.count,
+			   div_u64(e->cs.total_ns, NSEC_PER_USEC),
+			   e->cs.count ? div64_u64(e->cs.total_ns, e->cs.count) : 0,
+			   div_u64(e->cs.max_ns, NSEC_PER_USEC),
+			   (void *)e->cs.ip);
+
+		seq_puts(m, "    wait(us):");
+		debug_stats_seq_hist(m, e->hist, LC_HIST_BUCKETS);
+		seq_putc(m, '\n');
+	}
+	mutex_unlock(&lc_mutex);
+
+	vfree(merged);
+	return 0;
+}
+
+static int lc_top_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lc_top_show, NULL);
+}
+
+static const struct file_operations lc_top_fops = {
+	.open		= lc_top_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void lc_reset(void)
+{
+	callsite_table_reset(&lc_table);
+}
+
+static struct debug_stats_ctl lc_ctl = {
+	.key	= &lock_contention_key.key,
+	.lock	= &lc_mutex,
+	.reset	= lc_reset,
+};
+
+static int __init lock_contention_setup(char *str)
+{
+	lc_boot_enable = true;
+	return 1;
+}
+__setup("lock_contention", lock_contention_setup);
+
+static int __init lock_contention_init(void)
+{
+	struct dentry *dir;
+
+	if (callsite_table_init(&lc_table))
+		goto fail;
+
+	dir = debugfs_create_dir("lock_contention", NULL);
+	if (!dir)
+		goto fail;
+
+	debug_stats_create_ctl(dir, &lc_ctl);
+	debugfs_create_file("top", 0400, dir, NULL, &lc_top_fops);
+	debugfs_create_u32("nr_top", 0600, dir, &lc_nr_top);
+
+	if (lc_boot_enable)
+		static_branch_enable(&lock_contention_key);
+
+	return 0;
+
+fail:
+	callsite_table_destroy(&lc_table);
+	pr_warn("lock_contention: could not set up profiling\n");
+	return -ENOMEM;
+}
+late_initcall(lock_contention_init);
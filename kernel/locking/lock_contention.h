@@ -0,0 +1,61 @@
+/*
+ * Lightweight lock contention profiling
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * The slowpaths of the sleeping and spinning locks bracket the time they
+ * spend waiting with lock_contention_begin()/lock_contention_end(). When
+ * profiling is enabled the wait time is accounted to the call site of the
+ * lock operation, see kernel/locking/lock_contention.c.
+ */
+#ifndef __LOCKING_LOCK_CONTENTION_H
+#define __LOCKING_LOCK_CONTENTION_H
+
+#include <linux/jump_label.h>
+#include <linux/sched/clock.h>
+
+enum lock_contention_type {
+	LC_SPINLOCK,
+	LC_MUTEX,
+	LC_RWSEM_READ,
+	LC_RWSEM_WRITE,
+	LC_RTMUTEX,
+	LC_NR_TYPES,
+};
+
+#ifdef CONFIG_LOCK_CONTENTION_PROFILE
+
+DECLARE_STATIC_KEY_FALSE(lock_contention_key);
+
+extern void __lock_contention_end(u64 start, enum lock_contention_type type);
+
+/*
+ * Returns the start timestamp of a contended lock operation, or 0 when
+ * profiling is off.
+ */
+static __always_inline u64 lock_contention_begin(void)
+{
+	if (static_branch_unlikely(&lock_contention_key))
+		return local_clock();
+	return 0;
+}
+
+static __always_inline void
+lock_contention_end(u64 start, enum lock_contention_type type)
+{
+	if (start)
+		__lock_contention_end(start, type);
+}
+
+#else /* CONFIG_LOCK_CONTENTION_PROFILE */
+
+static inline u64 lock_contention_begin(void)			{ return 0; }
+static inline void
+lock_contention_end(u64 start, enum lock_contention_type type)	{ }
+
+#endif /* CONFIG_LOCK_CONTENTION_PROFILE */
+
+#endif /* __LOCKING_LOCK_CONTENTION_H */
@@ -40,6 +40,8 @@
 #include <linux/slab.h>
 #include <linux/percpu-rwsem.h>
 #include <linux/torture.h>
+#include <linux/sched/clock.h>
+#include <linux/debug_stats.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Paul E. McKenney <paulmck@us.ibm.com>");
@@ -59,6 +61,8 @@ torture_param(int, stat_interval, 60,
 torture_param(int, stutter, 5, "Number of jiffies to run/halt test, 0=disable");
 torture_param(bool, verbose, true,
 	     "Enable verbose debugging printk()s");
+torture_param(bool, lat_hist, true,
+	     "Print lock acquisition latency histograms");
 
 static char *torture_type = "spin_lock";
 module_param(torture_type, charp, 0444);
@@ -72,11 +76,22 @@ static struct task_struct **reader_tasks;
 static bool lock_is_write_held;
 static bool lock_is_read_held;
 
+/* acquisition latency histogram, see debug_stats_log2_bucket() */
+#define LOCK_LAT_BUCKETS	16
+
 struct lock_stress_stats {
 	long n_lock_fail;
 	long n_lock_acquired;
+	long lat_hist[LOCK_LAT_BUCKETS];
 };
 
+static void lock_torture_record_lat(struct lock_stress_stats *statp, u64 start)
+{
+	u64 delta = local_clock() - start;
+
+	statp->lat_hist[debug_stats_log2_bucket(delta, LOCK_LAT_BUCKETS)]++;
+}
+
 int torture_runnable = IS_ENABLED(MODULE);
 module_param(torture_runnable, int, 0444);
 MODULE_PARM_DESC(torture_runnable, "Start locktorture at module init");
@@ -228,6 +243,52 @@ static struct lock_torture_ops spin_lock_irq_ops = {
 	.name		= "spin_lock_irq"
 };
 
+#ifdef CONFIG_NUMA_AWARE_SPINLOCKS
+/*
+ * Drive the NUMA-aware qspinlock slowpath directly on a private lock, so
+ * that it gets covered whichever slowpath the system booted with.
+ */
+static struct qspinlock torture_cna_lock = __ARCH_SPIN_LOCK_UNLOCKED;
+
+static void torture_cna_spin_lock_init(void)
+{
+	if (cna_spin_lock_ready())
+		return;
+
+	pr_alert("lock-torture: CNA slowpath unavailable, using spin_lock\n");
+	cxt.cur_ops = &spin_lock_ops;
+}
+
+static int torture_cna_spin_lock_write_lock(void)
+{
+	u32 val;
+
+	preempt_disable();
+	val = atomic_cmpxchg_acquire(&torture_cna_lock.val, 0, _Q_LOCKED_VAL);
+	if (val)
+		__cna_queued_spin_lock_slowpath(&torture_cna_lock, val);
+	return 0;
+}
+
+static void torture_cna_spin_lock_write_unlock(void)
+{
+	native_queued_spin_unlock(&torture_cna_lock);
+	preempt_enable();
+}
+
+static struct lock_torture_ops cna_spin_lock_ops = {
+	.init		= torture_cna_spin_lock_init,
+	.writelock	= torture_cna_spin_lock_write_lock,
+	.write_delay	= torture_spin_lock_write_delay,
+	.task_boost     = torture_boost_dummy,
+	.writeunlock	= torture_cna_spin_lock_write_unlock,
+	.readlock       = NULL,
+	.read_delay     = NULL,
+	.readunlock     = NULL,
+	.name		= "spin_lock_cna"
+};
+#endif
+
 static DEFINE_RWLOCK(torture_rwlock);
 
 static int torture_rwlock_write_lock(void) __acquires(torture_rwlock)
@@ -646,6 +707,7 @@ static int lock_torture_writer(void *arg)
 {
 	struct lock_stress_stats *lwsp = arg;
 	static DEFINE_TORTURE_RANDOM(rand);
+	u64 start;
 
 	VERBOSE_TOROUT_STRING("lock_torture_writer task started");
 	set_user_nice(current, MAX_NICE);
@@ -655,7 +717,9 @@ static int lock_torture_writer(void *arg)
 			schedule_timeout_uninterruptible(1);
 
 		cxt.cur_ops->task_boost(&rand);
+		start = local_clock();
 		cxt.cur_ops->writelock();
+		lock_torture_record_lat(lwsp, start);
 		if (WARN_ON_ONCE(lock_is_write_held))
 			lwsp->n_lock_fail++;
 		lock_is_write_held = 1;
@@ -683,6 +747,7 @@ static int lock_torture_reader(void *arg)
 {
 	struct lock_stress_stats *lrsp = arg;
 	static DEFINE_TORTURE_RANDOM(rand);
+	u64 start;
 
 	VERBOSE_TOROUT_STRING("lock_torture_reader task started");
 	set_user_nice(current, MAX_NICE);
@@ -691,7 +756,9 @@ static int lock_torture_reader(void *arg)
 		if ((torture_random(&rand) & 0xfffff) == 0)
 			schedule_timeout_uninterruptible(1);
 
+		start = local_clock();
 		cxt.cur_ops->readlock();
+		lock_torture_record_lat(lrsp, start);
 		lock_is_read_held = 1;
 		if (WARN_ON_ONCE(lock_is_write_held))
 			lrsp->n_lock_fail++; /* rare, but... */
@@ -714,7 +781,7 @@ static void __torture_print_stats(char *page,
 				  struct lock_stress_stats *statp, bool write)
 {
 	bool fail = 0;
-	int i, n_stress;
+	int i, j, n_stress;
 	long max = 0;
 	long min = statp[0].n_lock_acquired;
 	long long sum = 0;
@@ -736,6 +803,25 @@ static void __torture_print_stats(char *page,
 			fail, fail ? "!!!" : "");
 	if (fail)
 		atomic_inc(&cxt.n_lock_torture_errors);
+
+	if (!lat_hist)
+		return;
+
+	/* Acquisition latency, summed over all threads of this class. */
+	page += sprintf(page, "%s latency (us):", write ? "Write" : "Read ");
+	for (j = 0; j < LOCK_LAT_BUCKETS; j++) {
+		long cnt = 0;
+
+		for (i = 0; i < n_stress; i++)
+			cnt += statp[i].lat_hist[j];
+		if (j == 0)
+			page += sprintf(page, " <1:%ld", cnt);
+		else if (j == LOCK_LAT_BUCKETS - 1)
+			page += sprintf(page, " >=%lu:%ld", 1UL << (j - 1), cnt);
+		else
+			page += sprintf(page, " %lu:%ld", 1UL << (j - 1), cnt);
+	}
+	sprintf(page, "\n");
 }
 
 /*
@@ -869,6 +955,9 @@ static int __init lock_torture_init(void)
 	static struct lock_torture_ops *torture_ops[] = {
 		&lock_busted_ops,
 		&spin_lock_ops, &spin_lock_irq_ops,
+#ifdef CONFIG_NUMA_AWARE_SPINLOCKS
+		&cna_spin_lock_ops,
+#endif
 		&rw_lock_ops, &rw_lock_irq_ops,
 		&mutex_lock_ops,
 		&ww_mutex_lock_ops,
@@ -932,6 +1021,7 @@ static int __init lock_torture_init(void)
 	for (i = 0; i < cxt.nrealwriters_stress; i++) {
 		cxt.lwsa[i].n_lock_fail = 0;
 		cxt.lwsa[i].n_lock_acquired = 0;
+		memset(cxt.lwsa[i].lat_hist, 0, sizeof(cxt.lwsa[i].lat_hist));
 	}
 
 	if (cxt.cur_ops->readlock) {
@@ -961,6 +1051,7 @@ static int __init lock_torture_init(void)
 		for (i = 0; i < cxt.nrealreaders_stress; i++) {
 			cxt.lrsa[i].n_lock_fail = 0;
 			cxt.lrsa[i].n_lock_acquired = 0;
+			memset(cxt.lrsa[i].lat_hist, 0, sizeof(cxt.lrsa[i].lat_hist));
 		}
 	}
 
@@ -35,6 +35,8 @@
 # include "mutex.h"
 #endif
 
+#include "lock_contention.h"
+
 void
 __mutex_init(struct mutex *lock, const char *name, struct lock_class_key *key)
 {
@@ -742,6 +744,7 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 	struct mutex_waiter waiter;
 	bool first = false;
 	struct ww_mutex *ww;
+	u64 lc_start;
 	int ret;
 
 	might_sleep();
@@ -755,16 +758,24 @@ __mutex_lock_common(struct mutex *lock, long state, unsigned int subclass,
 	preempt_disable();
 	mutex_acquire_nest(&lock->dep_map, subclass, 0, nest_lock, ip);
 
-	if (__mutex_trylock(lock) ||
-	    mutex_optimistic_spin(lock, ww_ctx, use_ww_ctx, NULL)) {
-		/* got the lock, yay! */
-		lock_acquired(&lock->dep_map, ip);
-		if (use_ww_ctx && ww_ctx)
-			ww_mutex_set_context_fastpath(ww, ww_ctx);
-		preempt_enable();
-		return 0;
+	/* Only account the acquisition as contended once the trylock failed */
+	if (__mutex_trylock(lock)) {
+		lc_start = 0;
+	} else {
+		lc_start = lock_contention_begin();
+		if (!mutex_optimistic_spin(lock, ww_ctx, use_ww_ctx, NULL))
+			goto slowpath;
 	}
 
+	/* got the lock, yay! */
+	lock_acquired(&lock->dep_map, ip);
+	lock_contention_end(lc_start, LC_MUTEX);
+	if (use_ww_ctx && ww_ctx)
+		ww_mutex_set_context_fastpath(ww, ww_ctx);
+	preempt_enable();
+	return 0;
+
+slowpath:
 	spin_lock(&lock->wait_lock);
 	/*
 	 * After waiting to acquire the wait_lock, try again.
@@ -867,6 +878,7 @@ acquired:
 skip_wait:
 	/* got the lock - cleanup and rejoice! */
 	lock_acquired(&lock->dep_map, ip);
+	lock_contention_end(lc_start, LC_MUTEX);
 
 	if (use_ww_ctx && ww_ctx)
 		ww_mutex_set_context_slowpath(ww, ww_ctx);
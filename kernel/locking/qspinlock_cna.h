@@ -0,0 +1,332 @@
+#ifndef _GEN_CNA_LOCK_SLOWPATH
+#error "do not include this file"
+#endif
+
+#include <linux/topology.h>
+
+/*
+ * Implement a NUMA-aware version of MCS (aka CNA, or compact NUMA-aware lock).
+ *
+ * In CNA, spinning threads are organized in two queues, a primary queue for
+ * threads running on the same NUMA node as the current lock holder, and a
+ * secondary queue for threads running on other nodes. Schematically, it
+ * looks like this:
+ *
+ *    cna_node
+ *   +----------+     +--------+         +--------+
+ *   |mcs:next  | --> |mcs:next| --> ... |mcs:next| --> NULL  [Primary queue]
+ *   |mcs:locked| -.  +--------+         +--------+
+ *   +----------+  |
+ *                 `----------------------.
+ *                                        v
+ *                 +--------+         +--------+
+ *                 |mcs:next| --> ... |mcs:next|            [Secondary queue]
+ *                 +--------+         +--------+
+ *                     ^                    |
+ *                     `--------------------'
+ *
+ * N.B. locked := 1 if secondary queue is absent. Otherwise, it contains the
+ * encoded pointer to the tail of the secondary queue, which is organized as a
+ * circular list.
+ *
+ * While the queue head waits for the lock owner to go away, it moves waiters
+ * running on other nodes (or whose vCPU has been preempted, as handing the
+ * lock to those would stall everybody behind them) from the primary queue to
+ * the secondary one, so that the lock is handed to a waiter on the local node
+ * next.
+ *
+ * Each local handoff with a non-empty secondary queue bumps intra_count, which
+ * travels with the lock. Once it reaches numa_spinlock_threshold, the
+ * secondary queue is spliced back in front of the primary one, which bounds
+ * how long remote waiters can be passed over.
+ *
+ * For more details, see https://arxiv.org/abs/1810.05600.
+ */
+
+struct cna_node {
+	struct mcs_spinlock	mcs;
+	struct mcs_spinlock	__res[3];
+
+	int			numa_node;
+	int			cpu;
+	u32			encoded_tail;
+	u32			intra_count;
+};
+
+/* intra_count value telling cna_pass_lock() to flush the secondary queue */
+#define CNA_FLUSH_SECONDARY_QUEUE	UINT_MAX
+
+/* number of local handoffs before the secondary queue is flushed */
+static unsigned int numa_spinlock_threshold __read_mostly = 1 << 10;
+
+static int __init numa_spinlock_threshold_setup(char *str)
+{
+	unsigned int val;
+
+	if (kstrtouint(str, 0, &val) || !val || val == CNA_FLUSH_SECONDARY_QUEUE)
+		return 0;
+
+	numa_spinlock_threshold = val;
+	return 1;
+}
+__setup("numa_spinlock_threshold=", numa_spinlock_threshold_setup);
+
+static void __init cna_init_nodes_per_cpu(unsigned int cpu)
+{
+	struct mcs_spinlock *base = per_cpu_ptr(&mcs_nodes[0], cpu);
+	int i;
+
+	for (i = 0; i < MAX_NODES / 2; i++) {
+		struct cna_node *cn = (struct cna_node *)(base + i);
+
+		cn->numa_node = cpu_to_node(cpu);
+		cn->cpu = cpu;
+		cn->encoded_tail = encode_tail(cpu, i);
+		/*
+		 * make sure @encoded_tail is not confused with other valid
+		 * values for @locked (0 or 1)
+		 */
+		WARN_ON(cn->encoded_tail <= 1);
+	}
+}
+
+static int __init cna_init_nodes(void)
+{
+	unsigned int cpu;
+
+	/*
+	 * Like pv_node, cna_node borrows the space of the following mcs
+	 * nodes; see the comment in pv_init_node().
+	 */
+	BUILD_BUG_ON(sizeof(struct cna_node) > 5*sizeof(struct mcs_spinlock));
+	BUILD_BUG_ON(MAX_NODES < 8);
+
+	for_each_possible_cpu(cpu)
+		cna_init_nodes_per_cpu(cpu);
+
+	return 0;
+}
+
+static __always_inline void cna_init_node(struct mcs_spinlock *node)
+{
+	((struct cna_node *)node)->intra_count = 0;
+}
+
+/*
+ * Should a waiter be skipped over when picking the next lock owner?
+ */
+static inline bool cna_skip_waiter(struct cna_node *cn, struct cna_node *waiter)
+{
+	return waiter->numa_node != cn->numa_node ||
+	       vcpu_is_preempted(waiter->cpu);
+}
+
+/*
+ * cna_splice_next -- move @next, the successor of @node, from the primary
+ * queue to the tail of the secondary queue.
+ */
+static void cna_splice_next(struct mcs_spinlock *node,
+			    struct mcs_spinlock *next,
+			    struct mcs_spinlock *nnext)
+{
+	/* remove @next from the primary queue */
+	node->next = nnext;
+
+	/* stick @next on the secondary queue tail */
+	if (node->locked <= 1) {
+		/* create the secondary queue */
+		next->next = next;
+	} else {
+		/* add to the tail of the secondary queue */
+		struct mcs_spinlock *tail_2nd = decode_tail(node->locked);
+		struct mcs_spinlock *head_2nd = tail_2nd->next;
+
+		tail_2nd->next = next;
+		next->next = head_2nd;
+	}
+
+	node->locked = ((struct cna_node *)next)->encoded_tail;
+	qstat_inc(qstat_cna_move_2nd, true);
+}
+
+/*
+ * cna_order_queue - check whether the successor of @node runs on the same
+ * NUMA node; if not, move it to the secondary queue.
+ *
+ * The last waiter of the primary queue is never moved, as it is the one the
+ * lock word's tail points to.
+ *
+ * Returns true once the successor is a waiter we are happy to hand the lock
+ * to.
+ */
+static bool cna_order_queue(struct mcs_spinlock *node)
+{
+	struct mcs_spinlock *next = READ_ONCE(node->next);
+	struct mcs_spinlock *nnext;
+
+	if (!next)
+		return false;
+
+	if (!cna_skip_waiter((struct cna_node *)node, (struct cna_node *)next))
+		return true;
+
+	nnext = READ_ONCE(next->next);
+	if (nnext)
+		cna_splice_next(node, next, nnext);
+
+	return false;
+}
+
+/*
+ * Called as the queue head while waiting for the owner and pending to go
+ * away. Use that time to reorder the queue, unless the fairness bound has
+ * been reached, in which case mark the secondary queue for flushing.
+ */
+static __always_inline u32 cna_wait_head_or_lock(struct qspinlock *lock,
+						 struct mcs_spinlock *node)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+
+	if (cn->intra_count < numa_spinlock_threshold) {
+		while ((atomic_read(&lock->val) & _Q_LOCKED_PENDING_MASK) &&
+		       !cna_order_queue(node))
+			cpu_relax();
+	} else {
+		cn->intra_count = CNA_FLUSH_SECONDARY_QUEUE;
+	}
+
+	return 0; /* we lied; we didn't wait, go do so now */
+}
+
+/*
+ * We are the last waiter in the primary queue; if there is a secondary
+ * queue, make it the primary one instead of releasing the tail.
+ */
+static __always_inline u32 cna_try_clear_tail(struct qspinlock *lock, u32 val,
+					      struct mcs_spinlock *node)
+{
+	struct mcs_spinlock *tail_2nd, *head_2nd;
+	u32 new, old;
+
+	if (node->locked <= 1)
+		return __try_clear_tail(lock, val, node);
+
+	/* the primary queue is empty, but the secondary one is not */
+	tail_2nd = decode_tail(node->locked);
+	head_2nd = tail_2nd->next;
+	new = ((struct cna_node *)tail_2nd)->encoded_tail + _Q_LOCKED_VAL;
+
+	old = atomic_cmpxchg_relaxed(&lock->val, val, new);
+	if (old == val) {
+		/* terminate the (former) secondary queue and pass the lock */
+		tail_2nd->next = NULL;
+		qstat_inc(qstat_cna_flush_2nd, true);
+		arch_mcs_spin_unlock_contended(&head_2nd->locked);
+	}
+
+	return old;
+}
+
+/*
+ * Hand the lock to our successor, carrying the secondary queue along, or
+ * flush the secondary queue in front of it once the fairness bound has been
+ * reached.
+ */
+static __always_inline void cna_pass_lock(struct mcs_spinlock *node,
+					  struct mcs_spinlock *next)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+	u32 val = 1;
+
+	/* cna_order_queue() may have changed our successor */
+	next = READ_ONCE(node->next);
+
+	if (node->locked > 1) {
+		if (cn->intra_count != CNA_FLUSH_SECONDARY_QUEUE) {
+			/* preserve the secondary queue */
+			val = node->locked;
+			((struct cna_node *)next)->intra_count =
+				cn->intra_count + 1;
+		} else {
+			struct mcs_spinlock *tail_2nd = decode_tail(node->locked);
+			struct mcs_spinlock *head_2nd = tail_2nd->next;
+
+			/* splice the secondary queue in front of @next */
+			tail_2nd->next = next;
+			next = head_2nd;
+			qstat_inc(qstat_cna_flush_2nd, true);
+		}
+	}
+
+	qstat_inc(qstat_cna_handoff_local,
+		  ((struct cna_node *)next)->numa_node == cn->numa_node);
+	qstat_inc(qstat_cna_handoff_remote,
+		  ((struct cna_node *)next)->numa_node != cn->numa_node);
+
+	smp_store_release(&next->locked, val);
+}
+
+/*
+ * Constant (boot-param configurable) flag selecting the NUMA-aware variant
+ * of spinlocks.
+ *
+ * The default value of -1 means "auto", i.e., use CNA on multi-node systems
+ * when the PV slowpath has not been installed.
+ */
+static int numa_spinlock_flag = -1;
+
+static int __init numa_spinlock_setup(char *str)
+{
+	if (!strcmp(str, "auto")) {
+		numa_spinlock_flag = -1;
+		return 1;
+	} else if (!strcmp(str, "on")) {
+		numa_spinlock_flag = 1;
+		return 1;
+	} else if (!strcmp(str, "off")) {
+		numa_spinlock_flag = 0;
+		return 1;
+	}
+
+	return 0;
+}
+__setup("numa_spinlock=", numa_spinlock_setup);
+
+static bool cna_nodes_ready __read_mostly;
+
+/*
+ * Can __cna_queued_spin_lock_slowpath() be used? True whenever the PV
+ * slowpath, which keeps its own state in the same space, is not in use;
+ * locktorture relies on this to exercise CNA on a private lock.
+ */
+bool cna_spin_lock_ready(void)
+{
+	return cna_nodes_ready;
+}
+EXPORT_SYMBOL_GPL(cna_spin_lock_ready);
+
+/*
+ * Switch to the NUMA-friendly slow path for spinlocks when we have
+ * multiple NUMA nodes in native environment, unless the user has
+ * overridden this default behavior by setting the numa_spinlock flag.
+ */
+void __init cna_configure_spin_lock_slowpath(void)
+{
+	if (pv_lock_ops.queued_spin_lock_slowpath !=
+			native_queued_spin_lock_slowpath) {
+		if (numa_spinlock_flag > 0)
+			pr_info("CNA spinlock unavailable with PV spinlocks\n");
+		return;
+	}
+
+	cna_init_nodes();
+	cna_nodes_ready = true;
+
+	if (!numa_spinlock_flag ||
+	    (numa_spinlock_flag < 0 && nr_node_ids == 1))
+		return;
+
+	pv_lock_ops.queued_spin_lock_slowpath = __cna_queued_spin_lock_slowpath;
+
+	pr_info("Enabling CNA spinlock\n");
+}
@@ -17,6 +17,10 @@
  * debugfs files will be created for reporting the counter values:
  *
  * <debugfs>/qlockstat/
+ *   cna_flush_2nd	- # of CNA secondary queue flushes (fairness bound)
+ *   cna_handoff_local	- # of CNA handoffs to a waiter on the same node
+ *   cna_handoff_remote	- # of CNA handoffs to a waiter on another node
+ *   cna_move_2nd	- # of waiters moved to the CNA secondary queue
  *   pv_hash_hops	- average # of hops per hashing operation
  *   pv_kick_unlock	- # of vCPU kicks issued at unlock time
  *   pv_kick_wake	- # of vCPU kicks used for computing pv_latency_wake
@@ -41,6 +45,10 @@
  * There may be slight difference between pv_kick_wake and pv_kick_unlock.
  */
 enum qlock_stats {
+	qstat_cna_flush_2nd,
+	qstat_cna_handoff_local,
+	qstat_cna_handoff_remote,
+	qstat_cna_move_2nd,
 	qstat_pv_hash_hops,
 	qstat_pv_kick_unlock,
 	qstat_pv_kick_wake,
@@ -67,6 +75,10 @@ enum qlock_stats {
 #include <linux/fs.h>
 
 static const char * const qstat_names[qstat_num + 1] = {
+	[qstat_cna_flush_2nd]	   = "cna_flush_2nd",
+	[qstat_cna_handoff_local]  = "cna_handoff_local",
+	[qstat_cna_handoff_remote] = "cna_handoff_remote",
+	[qstat_cna_move_2nd]	   = "cna_move_2nd",
 	[qstat_pv_hash_hops]	   = "pv_hash_hops",
 	[qstat_pv_kick_unlock]     = "pv_kick_unlock",
 	[qstat_pv_kick_wake]       = "pv_kick_wake",
@@ -233,7 +245,7 @@ out:
 fs_initcall(init_qspinlock_stat);
 
 /*
- * Increment the PV qspinlock statistical counters
+ * Increment the PV/CNA qspinlock statistical counters
  */
 static inline void qstat_inc(enum qlock_stats stat, bool cond)
 {
@@ -20,6 +20,7 @@
 #include <linux/timer.h>
 
 #include "rtmutex_common.h"
+#include "lock_contention.h"
 
 /*
  * lock->owner state tracking:
@@ -1246,6 +1247,7 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 		  enum rtmutex_chainwalk chwalk)
 {
 	struct rt_mutex_waiter waiter;
+	u64 lc_start = lock_contention_begin();
 	unsigned long flags;
 	int ret = 0;
 
@@ -1264,6 +1266,7 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 	/* Try to acquire the lock again: */
 	if (try_to_take_rt_mutex(lock, current, NULL)) {
 		raw_spin_unlock_irqrestore(&lock->wait_lock, flags);
+		lock_contention_end(lc_start, LC_RTMUTEX);
 		return 0;
 	}
 
@@ -1300,6 +1303,9 @@ rt_mutex_slowlock(struct rt_mutex *lock, int state,
 
 	debug_rt_mutex_free_waiter(&waiter);
 
+	if (!ret)
+		lock_contention_end(lc_start, LC_RTMUTEX);
+
 	return ret;
 }
 
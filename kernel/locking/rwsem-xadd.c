@@ -19,6 +19,7 @@
 #include <linux/osq_lock.h>
 
 #include "rwsem.h"
+#include "lock_contention.h"
 
 /*
  * Guide to the rw_semaphore's count field for common values.
@@ -87,6 +88,7 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 	INIT_LIST_HEAD(&sem->wait_list);
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	sem->owner = NULL;
+	sem->handoff = 0;
 	osq_lock_init(&sem->osq);
 #endif
 }
@@ -102,8 +104,54 @@ struct rwsem_waiter {
 	struct list_head list;
 	struct task_struct *task;
 	enum rwsem_waiter_type type;
+	unsigned long timeout;
 };
 
+/*
+ * A writer that has been at the head of the wait queue for longer than
+ * RWSEM_WAIT_TIMEOUT sets sem->handoff. Optimistic spinners, readers and
+ * writers alike, then stay off the lock and queue instead, so that the next
+ * time the lock is free it goes to that writer. This bounds how long
+ * spinners can starve a sleeping writer.
+ */
+#define RWSEM_WAIT_TIMEOUT	DIV_ROUND_UP(HZ, 250)
+
+#ifdef CONFIG_RWSEM_SPIN_ON_OWNER
+static inline bool rwsem_handoff_pending(struct rw_semaphore *sem)
+{
+	return READ_ONCE(sem->handoff);
+}
+
+/* Must be called with sem->wait_lock held */
+static inline void rwsem_set_handoff(struct rw_semaphore *sem, bool on)
+{
+	WRITE_ONCE(sem->handoff, on);
+}
+#else
+/* Without spinners nobody can jump the queue; no handoff needed. */
+static inline bool rwsem_handoff_pending(struct rw_semaphore *sem)
+{
+	return false;
+}
+
+static inline void rwsem_set_handoff(struct rw_semaphore *sem, bool on)
+{
+}
+#endif
+
+/*
+ * The head of the queue is leaving it (lock taken or wait interrupted);
+ * the handoff request, if any, was its own. Called with wait_lock held.
+ */
+static inline void rwsem_clear_handoff_first(struct rw_semaphore *sem,
+					     struct rwsem_waiter *waiter)
+{
+	if (rwsem_handoff_pending(sem) &&
+	    list_first_entry(&sem->wait_list, struct rwsem_waiter,
+			     list) == waiter)
+		rwsem_set_handoff(sem, false);
+}
+
 enum rwsem_wake_type {
 	RWSEM_WAKE_ANY,		/* Wake whatever's at head of wait list */
 	RWSEM_WAKE_READERS,	/* Wake readers only */
@@ -218,6 +266,8 @@ static void __rwsem_mark_wake(struct rw_semaphore *sem,
 		atomic_long_add(adjustment, &sem->count);
 }
 
+static bool rwsem_reader_optimistic_spin(struct rw_semaphore *sem);
+
 /*
  * Wait for the read lock to be granted
  */
@@ -226,8 +276,19 @@ struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
 {
 	long count, adjustment = -RWSEM_ACTIVE_READ_BIAS;
 	struct rwsem_waiter waiter;
+	u64 lc_start = lock_contention_begin();
 	DEFINE_WAKE_Q(wake_q);
 
+	/*
+	 * Spin while a running writer owns the lock; our read bias is still
+	 * in the count, so we own the lock once the writer releases it and
+	 * nobody is queued.
+	 */
+	if (rwsem_reader_optimistic_spin(sem)) {
+		lock_contention_end(lc_start, LC_RWSEM_READ);
+		return sem;
+	}
+
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_READ;
 
@@ -262,6 +323,7 @@ struct rw_semaphore __sched *rwsem_down_read_failed(struct rw_semaphore *sem)
 	}
 
 	__set_current_state(TASK_RUNNING);
+	lock_contention_end(lc_start, LC_RWSEM_READ);
 	return sem;
 }
 EXPORT_SYMBOL(rwsem_down_read_failed);
@@ -271,14 +333,28 @@ EXPORT_SYMBOL(rwsem_down_read_failed);
  * race conditions between checking the rwsem wait list and setting the
  * sem->count accordingly.
  */
-static inline bool rwsem_try_write_lock(long count, struct rw_semaphore *sem)
+static inline bool rwsem_try_write_lock(long count, struct rw_semaphore *sem,
+					struct rwsem_waiter *waiter,
+					struct wake_q_head *wake_q)
 {
+	struct rwsem_waiter *first;
+
 	/*
 	 * Avoid trying to acquire write lock if count isn't RWSEM_WAITING_BIAS.
 	 */
 	if (count != RWSEM_WAITING_BIAS)
 		return false;
 
+	/*
+	 * The lock is reserved for the head of the queue; make sure it is
+	 * awake to take it once wait_lock has been dropped.
+	 */
+	first = list_first_entry(&sem->wait_list, struct rwsem_waiter, list);
+	if (rwsem_handoff_pending(sem) && first != waiter) {
+		wake_q_add(wake_q, first->task);
+		return false;
+	}
+
 	/*
 	 * Acquire the lock by trying to set it to ACTIVE_WRITE_BIAS. If there
 	 * are other tasks on the wait list, we need to add on WAITING_BIAS.
@@ -304,6 +380,9 @@ static inline bool rwsem_try_write_lock_unqueued(struct rw_semaphore *sem)
 {
 	long old, count = atomic_long_read(&sem->count);
 
+	if (rwsem_handoff_pending(sem))
+		return false;
+
 	while (true) {
 		if (!(count == 0 || count == RWSEM_WAITING_BIAS))
 			return false;
@@ -324,7 +403,7 @@ static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 	struct task_struct *owner;
 	bool ret = true;
 
-	if (need_resched())
+	if (need_resched() || rwsem_handoff_pending(sem))
 		return false;
 
 	rcu_read_lock();
@@ -440,6 +519,55 @@ done:
 	return taken;
 }
 
+/*
+ * Reader optimistic spinning, called with the read bias added by
+ * __down_read() still in the count.
+ *
+ * While that bias is there no writer can take the lock, so once the
+ * owning writer goes away a positive count (no writer, nobody queued)
+ * means we hold the read lock. Any other outcome is left to the queueing
+ * slowpath, which knows how to undo the bias.  In particular we must not
+ * keep spinning on a lock without a writing owner: with a writer queued
+ * the count stays negative, and our bias keeps that writer from ever
+ * getting the lock.
+ *
+ * Readers don't go through the osq: they can all take the lock at the
+ * same time, so serializing them would only add latency.
+ */
+static bool rwsem_reader_optimistic_spin(struct rw_semaphore *sem)
+{
+	bool taken = false;
+
+	preempt_disable();
+
+	if (!rwsem_owner_is_writer(READ_ONCE(sem->owner)) ||
+	    !rwsem_can_spin_on_owner(sem))
+		goto done;
+
+	while (true) {
+		if (atomic_long_read(&sem->count) > 0) {
+			taken = true;
+			break;
+		}
+
+		if (!rwsem_owner_is_writer(READ_ONCE(sem->owner)))
+			break;
+
+		if (!rwsem_spin_on_owner(sem) || rwsem_handoff_pending(sem))
+			break;
+
+		cpu_relax();
+	}
+
+	if (!taken && atomic_long_read(&sem->count) > 0)
+		taken = true;
+	if (taken)
+		rwsem_set_reader_owned(sem);
+done:
+	preempt_enable();
+	return taken;
+}
+
 /*
  * Return true if the rwsem has active spinner
  */
@@ -454,6 +582,11 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 	return false;
 }
 
+static bool rwsem_reader_optimistic_spin(struct rw_semaphore *sem)
+{
+	return false;
+}
+
 static inline bool rwsem_has_spinner(struct rw_semaphore *sem)
 {
 	return false;
@@ -470,14 +603,17 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	bool waiting = true; /* any queued threads before us */
 	struct rwsem_waiter waiter;
 	struct rw_semaphore *ret = sem;
+	u64 lc_start = lock_contention_begin();
 	DEFINE_WAKE_Q(wake_q);
 
 	/* undo write bias from down_write operation, stop active locking */
 	count = atomic_long_sub_return(RWSEM_ACTIVE_WRITE_BIAS, &sem->count);
 
 	/* do optimistic spinning and steal lock if possible */
-	if (rwsem_optimistic_spin(sem))
+	if (rwsem_optimistic_spin(sem)) {
+		lock_contention_end(lc_start, LC_RWSEM_WRITE);
 		return sem;
+	}
 
 	/*
 	 * Optimistic spinning failed, proceed to the slowpath
@@ -485,6 +621,7 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	 */
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_WRITE;
+	waiter.timeout = jiffies + RWSEM_WAIT_TIMEOUT;
 
 	raw_spin_lock_irq(&sem->wait_lock);
 
@@ -526,10 +663,25 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	/* wait until we successfully acquire the lock */
 	set_current_state(state);
 	while (true) {
-		if (rwsem_try_write_lock(count, sem))
+		if (rwsem_try_write_lock(count, sem, &waiter, &wake_q))
 			break;
+
+		/*
+		 * We have been at the head of the queue for too long, ask for
+		 * the lock to be handed to us.
+		 */
+		if (!rwsem_handoff_pending(sem) &&
+		    list_first_entry(&sem->wait_list, struct rwsem_waiter,
+				     list) == &waiter &&
+		    time_after(jiffies, waiter.timeout))
+			rwsem_set_handoff(sem, true);
+
 		raw_spin_unlock_irq(&sem->wait_lock);
 
+		/* Kick the head of the queue if a handoff is pending */
+		wake_up_q(&wake_q);
+		wake_q_init(&wake_q);
+
 		/* Block until there are no active lockers. */
 		do {
 			if (signal_pending_state(state, current))
@@ -542,14 +694,17 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 		raw_spin_lock_irq(&sem->wait_lock);
 	}
 	__set_current_state(TASK_RUNNING);
+	rwsem_clear_handoff_first(sem, &waiter);
 	list_del(&waiter.list);
 	raw_spin_unlock_irq(&sem->wait_lock);
+	lock_contention_end(lc_start, LC_RWSEM_WRITE);
 
 	return ret;
 
 out_nolock:
 	__set_current_state(TASK_RUNNING);
 	raw_spin_lock_irq(&sem->wait_lock);
+	rwsem_clear_handoff_first(sem, &waiter);
 	list_del(&waiter.list);
 	if (list_empty(&sem->wait_list))
 		atomic_long_add(-RWSEM_WAITING_BIAS, &sem->count);
@@ -47,6 +47,8 @@
 #include <asm/byteorder.h>
 #include <linux/torture.h>
 #include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+#include <linux/sched/clock.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Paul E. McKenney <paulmck@linux.vnet.ibm.com>");
@@ -59,6 +61,9 @@ MODULE_AUTHOR("Paul E. McKenney <paulmck@linux.vnet.ibm.com>");
 #define VERBOSE_PERFOUT_ERRSTRING(s) \
 	do { if (verbose) pr_alert("%s" PERF_FLAG "!!! %s\n", perf_type, s); } while (0)
 
+torture_param(int, cbflood, 0, "Callbacks per flood burst, 0 to disable");
+torture_param(bool, cbflood_lazy, false, "Flood with call_rcu_lazy()");
+torture_param(int, cbflood_holdoff, 1, "Time between flood bursts (jiffies)");
 torture_param(bool, gp_exp, false, "Use expedited GP wait primitives");
 torture_param(int, holdoff, 10, "Holdoff time before test start (s)");
 torture_param(int, nreaders, -1, "Number of RCU reader threads");
@@ -87,6 +92,39 @@ static u64 t_rcu_perf_writer_finished;
 static unsigned long b_rcu_perf_writer_started;
 static unsigned long b_rcu_perf_writer_finished;
 
+/*
+ * Callback-flood state, one per writer CPU.  While the flooder posts
+ * bursts of callbacks, an hrtimer schedules a tasklet every millisecond
+ * and records how long it takes to run: softirq handlers run one after
+ * the other, so this measures how long callback invocation holds up the
+ * other softirq work on that CPU.
+ */
+struct rcu_perf_cbflood_cb {
+	struct rcu_head rh;
+	struct rcu_perf_cbflood *rpcf;
+};
+
+struct rcu_perf_cbflood {
+	struct rcu_perf_cbflood_cb *cbs;
+	atomic_t outstanding;		/* Callbacks not yet invoked. */
+	wait_queue_head_t wq;
+	unsigned long n_bursts;
+	atomic_long_t n_cbs_task;	/* Callbacks invoked from a task. */
+	unsigned long gp_first;		/* GPs completed at first invocation, */
+	unsigned long gp_last;		/* ... and at last, of this burst. */
+	unsigned long n_split;		/* Bursts spanning more than one GP. */
+	struct hrtimer probe_timer;
+	struct tasklet_struct probe_tasklet;
+	u64 probe_t;			/* When probe_tasklet was scheduled. */
+	u64 lat_sum;
+	u64 lat_max;
+	unsigned long n_lat;
+	unsigned long n_lat_over_1ms;
+};
+
+static struct task_struct **cbflood_tasks;
+static struct rcu_perf_cbflood *cbflood_state;
+
 static int rcu_perf_writer_state;
 #define RTWS_INIT		0
 #define RTWS_EXP_SYNC		1
@@ -116,6 +154,8 @@ struct rcu_perf_ops {
 	unsigned long (*exp_completed)(void);
 	void (*sync)(void);
 	void (*exp_sync)(void);
+	call_rcu_func_t call;
+	void (*cb_barrier)(void);
 	const char *name;
 };
 
@@ -155,6 +195,8 @@ static struct rcu_perf_ops rcu_ops = {
 	.exp_completed	= rcu_exp_batches_completed,
 	.sync		= synchronize_rcu,
 	.exp_sync	= synchronize_rcu_expedited,
+	.call		= call_rcu,
+	.cb_barrier	= rcu_barrier,
 	.name		= "rcu"
 };
 
@@ -183,6 +225,8 @@ static struct rcu_perf_ops rcu_bh_ops = {
 	.exp_completed	= rcu_exp_batches_completed_sched,
 	.sync		= synchronize_rcu_bh,
 	.exp_sync	= synchronize_rcu_bh_expedited,
+	.call		= call_rcu_bh,
+	.cb_barrier	= rcu_barrier_bh,
 	.name		= "rcu_bh"
 };
 
@@ -218,6 +262,16 @@ static void srcu_perf_synchronize_expedited(void)
 	synchronize_srcu_expedited(srcu_ctlp);
 }
 
+static void srcu_perf_call(struct rcu_head *head, rcu_callback_t func)
+{
+	call_srcu(srcu_ctlp, head, func);
+}
+
+static void srcu_perf_barrier(void)
+{
+	srcu_barrier(srcu_ctlp);
+}
+
 static struct rcu_perf_ops srcu_ops = {
 	.ptype		= SRCU_FLAVOR,
 	.init		= rcu_sync_perf_init,
@@ -228,6 +282,8 @@ static struct rcu_perf_ops srcu_ops = {
 	.exp_completed	= srcu_perf_completed,
 	.sync		= srcu_perf_synchronize,
 	.exp_sync	= srcu_perf_synchronize_expedited,
+	.call		= srcu_perf_call,
+	.cb_barrier	= srcu_perf_barrier,
 	.name		= "srcu"
 };
 
@@ -256,6 +312,8 @@ static struct rcu_perf_ops sched_ops = {
 	.exp_completed	= rcu_exp_batches_completed_sched,
 	.sync		= synchronize_sched,
 	.exp_sync	= synchronize_sched_expedited,
+	.call		= call_rcu_sched,
+	.cb_barrier	= rcu_barrier_sched,
 	.name		= "sched"
 };
 
@@ -283,6 +341,8 @@ static struct rcu_perf_ops tasks_ops = {
 	.completed	= rcu_no_completed,
 	.sync		= synchronize_rcu_tasks,
 	.exp_sync	= synchronize_rcu_tasks,
+	.call		= call_rcu_tasks,
+	.cb_barrier	= rcu_barrier_tasks,
 	.name		= "tasks"
 };
 
@@ -435,12 +495,174 @@ rcu_perf_writer(void *arg)
 	return 0;
 }
 
+static void rcu_perf_cbflood_cb(struct rcu_head *rhp)
+{
+	struct rcu_perf_cbflood_cb *cb =
+		container_of(rhp, struct rcu_perf_cbflood_cb, rh);
+	struct rcu_perf_cbflood *rpcf = cb->rpcf;
+	unsigned long gp = cur_ops->completed();
+
+	if (!in_serving_softirq())
+		atomic_long_inc(&rpcf->n_cbs_task);
+
+	/* A burst's callbacks are invoked one after another on its CPU. */
+	if (atomic_read(&rpcf->outstanding) == cbflood)
+		rpcf->gp_first = gp;
+	if (atomic_dec_and_test(&rpcf->outstanding)) {
+		rpcf->gp_last = gp;
+		wake_up(&rpcf->wq);
+	}
+}
+
+static void rcu_perf_cbflood_probe_tasklet(unsigned long arg)
+{
+	struct rcu_perf_cbflood *rpcf = (struct rcu_perf_cbflood *)arg;
+	u64 lat = local_clock() - rpcf->probe_t;
+
+	rpcf->lat_sum += lat;
+	if (lat > rpcf->lat_max)
+		rpcf->lat_max = lat;
+	if (lat > NSEC_PER_MSEC)
+		rpcf->n_lat_over_1ms++;
+	rpcf->n_lat++;
+}
+
+static enum hrtimer_restart rcu_perf_cbflood_probe(struct hrtimer *timer)
+{
+	struct rcu_perf_cbflood *rpcf =
+		container_of(timer, struct rcu_perf_cbflood, probe_timer);
+
+	/* Don't pile up, a late tasklet is counted once. */
+	if (!test_bit(TASKLET_STATE_SCHED, &rpcf->probe_tasklet.state)) {
+		rpcf->probe_t = local_clock();
+		tasklet_schedule(&rpcf->probe_tasklet);
+	}
+	hrtimer_forward_now(timer, ms_to_ktime(1));
+	return HRTIMER_RESTART;
+}
+
+/*
+ * RCU perf callback-flood kthread.  Repeatedly posts a burst of cbflood
+ * callbacks and waits for them to be invoked, while probing the softirq
+ * latency on its CPU.
+ */
+static int
+rcu_perf_cbflood(void *arg)
+{
+	long me = (long)arg;
+	struct rcu_perf_cbflood *rpcf = &cbflood_state[me];
+	call_rcu_func_t call = cbflood_lazy ? call_rcu_lazy : cur_ops->call;
+	int i;
+
+	VERBOSE_PERFOUT_STRING("rcu_perf_cbflood task started");
+	set_cpus_allowed_ptr(current, cpumask_of(me % nr_cpu_ids));
+
+	if (holdoff)
+		schedule_timeout_uninterruptible(holdoff * HZ);
+
+	/* Pinned, so that the probe measures this CPU's softirqs. */
+	hrtimer_start(&rpcf->probe_timer, ms_to_ktime(1),
+		      HRTIMER_MODE_REL_PINNED);
+
+	do {
+		atomic_set(&rpcf->outstanding, cbflood);
+		for (i = 0; i < cbflood; i++) {
+			rpcf->cbs[i].rpcf = rpcf;
+			call(&rpcf->cbs[i].rh, rcu_perf_cbflood_cb);
+		}
+		wait_event(rpcf->wq, !atomic_read(&rpcf->outstanding));
+		rpcf->n_bursts++;
+		if (rpcf->gp_last != rpcf->gp_first)
+			rpcf->n_split++;
+		schedule_timeout_uninterruptible(cbflood_holdoff);
+		rcu_perf_wait_shutdown();
+	} while (!torture_must_stop());
+
+	hrtimer_cancel(&rpcf->probe_timer);
+	tasklet_kill(&rpcf->probe_tasklet);
+	torture_kthread_stopping("rcu_perf_cbflood");
+	return 0;
+}
+
+static void rcu_perf_cbflood_cleanup(void)
+{
+	struct rcu_perf_cbflood *rpcf;
+	int i;
+
+	if (cbflood_tasks) {
+		for (i = 0; i < nrealwriters; i++)
+			torture_stop_kthread(rcu_perf_cbflood,
+					     cbflood_tasks[i]);
+		kfree(cbflood_tasks);
+		cbflood_tasks = NULL;
+	}
+	if (!cbflood_state)
+		return;
+
+	/* Callbacks may still be running, and touching cbflood_state. */
+	cur_ops->cb_barrier();
+
+	for (i = 0; i < nrealwriters; i++) {
+		rpcf = &cbflood_state[i];
+		pr_alert("%s%s cbflood %d: bursts: %lu split: %lu task-cbs: %lu softirq-latency avg: %llu max: %llu ns >1ms: %lu\n",
+			 perf_type, PERF_FLAG, i, rpcf->n_bursts, rpcf->n_split,
+			 atomic_long_read(&rpcf->n_cbs_task),
+			 rpcf->n_lat ? div64_u64(rpcf->lat_sum, rpcf->n_lat) : 0,
+			 rpcf->lat_max, rpcf->n_lat_over_1ms);
+		/* With rcutree.lazy_jiffies set, a lazy burst is one GP. */
+		if (cbflood_lazy && rpcf->n_split)
+			VERBOSE_PERFOUT_ERRSTRING("lazy cbflood burst split across grace periods");
+		vfree(rpcf->cbs);
+	}
+	kfree(cbflood_state);
+	cbflood_state = NULL;
+}
+
+static int __init rcu_perf_cbflood_init(void)
+{
+	struct rcu_perf_cbflood *rpcf;
+	long i;
+	int err;
+
+	if (cbflood_lazy && cur_ops != &rcu_ops) {
+		VERBOSE_PERFOUT_ERRSTRING("cbflood_lazy needs perf_type=rcu");
+		return -EINVAL;
+	}
+	cbflood_tasks = kcalloc(nrealwriters, sizeof(cbflood_tasks[0]),
+				GFP_KERNEL);
+	cbflood_state = kcalloc(nrealwriters, sizeof(cbflood_state[0]),
+				GFP_KERNEL);
+	if (!cbflood_tasks || !cbflood_state)
+		return -ENOMEM;
+	for (i = 0; i < nrealwriters; i++) {
+		rpcf = &cbflood_state[i];
+		rpcf->cbs = vzalloc(cbflood * sizeof(rpcf->cbs[0]));
+		if (!rpcf->cbs)
+			return -ENOMEM;
+		init_waitqueue_head(&rpcf->wq);
+		hrtimer_init(&rpcf->probe_timer, CLOCK_MONOTONIC,
+			     HRTIMER_MODE_REL_PINNED);
+		rpcf->probe_timer.function = rcu_perf_cbflood_probe;
+		tasklet_init(&rpcf->probe_tasklet,
+			     rcu_perf_cbflood_probe_tasklet,
+			     (unsigned long)rpcf);
+	}
+	for (i = 0; i < nrealwriters; i++) {
+		err = torture_create_kthread(rcu_perf_cbflood, (void *)i,
+					     cbflood_tasks[i]);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
 static inline void
 rcu_perf_print_module_parms(struct rcu_perf_ops *cur_ops, const char *tag)
 {
 	pr_alert("%s" PERF_FLAG
-		 "--- %s: nreaders=%d nwriters=%d verbose=%d shutdown=%d\n",
-		 perf_type, tag, nrealreaders, nrealwriters, verbose, shutdown);
+		 "--- %s: nreaders=%d nwriters=%d verbose=%d shutdown=%d cbflood=%d cbflood_lazy=%d\n",
+		 perf_type, tag, nrealreaders, nrealwriters, verbose, shutdown,
+		 cbflood, cbflood_lazy);
 }
 
 static void
@@ -455,6 +677,8 @@ rcu_perf_cleanup(void)
 	if (torture_cleanup_begin())
 		return;
 
+	rcu_perf_cbflood_cleanup();
+
 	if (reader_tasks) {
 		for (i = 0; i < nrealreaders; i++)
 			torture_stop_kthread(rcu_perf_reader,
@@ -647,6 +871,11 @@ rcu_perf_init(void)
 		if (firsterr)
 			goto unwind;
 	}
+	if (cbflood > 0) {
+		firsterr = rcu_perf_cbflood_init();
+		if (firsterr)
+			goto unwind;
+	}
 	torture_init_end();
 	return 0;
 
@@ -72,6 +72,9 @@ EXPORT_SYMBOL(__rcu_is_watching);
 
 #endif /* defined(CONFIG_DEBUG_LOCK_ALLOC) || defined(CONFIG_RCU_TRACE) */
 
+/* Count of quiescent states, each being a grace period on UP. */
+static unsigned long rcu_sched_qs_seq;
+
 /*
  * Helper function for rcu_sched_qs() and rcu_bh_qs().
  * Also irqs are disabled to avoid confusion due to interrupt handlers
@@ -98,12 +101,30 @@ void rcu_sched_qs(void)
 	unsigned long flags;
 
 	local_irq_save(flags);
+	WRITE_ONCE(rcu_sched_qs_seq, rcu_sched_qs_seq + 1);
 	if (rcu_qsctr_help(&rcu_sched_ctrlblk) +
 	    rcu_qsctr_help(&rcu_bh_ctrlblk))
 		raise_softirq(RCU_SOFTIRQ);
 	local_irq_restore(flags);
 }
 
+/*
+ * Polling grace-period API.  With a single CPU, any quiescent state
+ * recorded after the cookie was taken is a full grace period, and one
+ * is bound to happen without any prodding.
+ */
+unsigned long start_poll_synchronize_sched(void)
+{
+	return READ_ONCE(rcu_sched_qs_seq);
+}
+EXPORT_SYMBOL_GPL(start_poll_synchronize_sched);
+
+bool poll_state_synchronize_sched(unsigned long oldstate)
+{
+	return READ_ONCE(rcu_sched_qs_seq) != oldstate;
+}
+EXPORT_SYMBOL_GPL(poll_state_synchronize_sched);
+
 /*
  * Record an rcu_bh quiescent state.
  */
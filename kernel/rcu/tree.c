@@ -58,6 +58,7 @@
 #include <linux/trace_events.h>
 #include <linux/suspend.h>
 #include <linux/ftrace.h>
+#include <linux/slab.h>
 
 #include "tree.h"
 #include "rcu.h"
@@ -537,10 +538,16 @@ EXPORT_SYMBOL_GPL(rcu_all_qs);
 static long blimit = 10;	/* Maximum callbacks per rcu_do_batch. */
 static long qhimark = 10000;	/* If this many pending, ignore blimit. */
 static long qlowmark = 100;	/* Once only this many pending, use blimit. */
+static long offload_qlen;	/* If this many pending, use rcuo_node. */
+static ulong lazy_jiffies;	/* Max GP delay for lazy-only callbacks. */
 
 module_param(blimit, long, 0444);
 module_param(qhimark, long, 0444);
 module_param(qlowmark, long, 0444);
+module_param(offload_qlen, long, 0644);
+module_param(lazy_jiffies, ulong, 0644);
+
+static struct rcu_offload_node *rcu_offload_nodes;
 
 static ulong jiffies_till_first_fqs = ULONG_MAX;
 static ulong jiffies_till_next_fqs = ULONG_MAX;
@@ -760,6 +767,27 @@ static int rcu_future_needs_gp(struct rcu_state *rsp)
 	return READ_ONCE(*fp);
 }
 
+/*
+ * Should the grace period for this CPU's pending callbacks be put off for
+ * now?  Only if all of them are lazy, the oldest has waited less than
+ * lazy_jiffies, and there are not too many, so that bursts of kfree_rcu()
+ * and call_rcu_lazy() share a single grace period rather than each
+ * requesting their own.  This holds across all pending segments: lazy
+ * callbacks that got accelerated into RCU_WAIT_TAIL are still deferred,
+ * and later arrivals do not restart the window.  Non-lazy callbacks end
+ * the deferral, and lazy ones that arrive while a grace period is needed
+ * anyway simply ride along.  The caller must have disabled interrupts.
+ */
+static bool rcu_lazy_defer(struct rcu_data *rdp)
+{
+	unsigned long window = READ_ONCE(lazy_jiffies);
+
+	return window && rdp->lazy_only &&
+	       rcu_segcblist_pend_cbs(&rdp->cblist) &&
+	       rcu_segcblist_n_cbs(&rdp->cblist) < qhimark &&
+	       time_before(jiffies, rdp->lazy_start + window);
+}
+
 /*
  * Does the current CPU require a not-yet-started grace period?
  * The caller must have disabled interrupts to prevent races with
@@ -774,10 +802,12 @@ cpu_needs_another_gp(struct rcu_state *rsp, struct rcu_data *rdp)
 		return true;  /* Yes, a no-CBs CPU needs one. */
 	if (!rcu_segcblist_is_enabled(&rdp->cblist))
 		return false;  /* No, this is a no-CBs (or offline) CPU. */
-	if (!rcu_segcblist_restempty(&rdp->cblist, RCU_NEXT_READY_TAIL))
+	if (!rcu_segcblist_restempty(&rdp->cblist, RCU_NEXT_READY_TAIL) &&
+	    !rcu_lazy_defer(rdp))
 		return true;  /* Yes, CPU has newly registered callbacks. */
 	if (rcu_segcblist_future_gp_needed(&rdp->cblist,
-					   READ_ONCE(rsp->completed)))
+					   READ_ONCE(rsp->completed)) &&
+	    !rcu_lazy_defer(rdp))
 		return true;  /* Yes, CBs for future grace period. */
 	return false; /* No grace period needed. */
 }
@@ -1844,11 +1874,19 @@ static bool rcu_accelerate_cbs(struct rcu_state *rsp, struct rcu_node *rnp,
 			       struct rcu_data *rdp)
 {
 	bool ret = false;
+	bool lazy;
 
 	/* If no pending (not yet ready to invoke) callbacks, nothing to do. */
 	if (!rcu_segcblist_pend_cbs(&rdp->cblist))
 		return false;
 
+	/*
+	 * Lazy callbacks still get accelerated, so that they ride along with
+	 * any grace period that is already running or requested, but they
+	 * do not request a new one for a while, see rcu_lazy_defer().
+	 */
+	lazy = rcu_lazy_defer(rdp);
+
 	/*
 	 * Callbacks are often registered with incomplete grace-period
 	 * information.  Something about the fact that getting exact
@@ -1859,7 +1897,8 @@ static bool rcu_accelerate_cbs(struct rcu_state *rsp, struct rcu_node *rnp,
 	 * accelerating callback invocation to an earlier grace-period
 	 * number.
 	 */
-	if (rcu_segcblist_accelerate(&rdp->cblist, rcu_cbs_completed(rsp, rnp)))
+	if (rcu_segcblist_accelerate(&rdp->cblist, rcu_cbs_completed(rsp, rnp)) &&
+	    !lazy)
 		ret = rcu_start_future_gp(rnp, rdp, NULL);
 
 	/* Trace depending on how much we were able to accelerate. */
@@ -2757,6 +2796,139 @@ static void rcu_cleanup_dead_cpu(int cpu, struct rcu_state *rsp)
 		  rcu_segcblist_first_cb(&rdp->cblist));
 }
 
+/*
+ * Hand the ready callbacks extracted into @rcl over to the rcuo_node
+ * kthread of this CPU's NUMA node instead of invoking them here, so that
+ * a large backlog does not turn into a long softirq run on a CPU that
+ * may have better things to do.  Only done once more than offload_qlen
+ * callbacks are queued.  On success, @rcl is left empty, with counts
+ * as if its callbacks had been invoked.
+ */
+static bool rcu_offload_cbs(struct rcu_data *rdp, struct rcu_cblist *rcl)
+{
+	struct rcu_offload_node *ron = READ_ONCE(rcu_offload_nodes);
+	long thresh = READ_ONCE(offload_qlen);
+	long n = 0, n_lazy = 0;
+	struct rcu_head *rhp;
+	unsigned long flags;
+
+	if (!thresh || rcu_segcblist_n_cbs(&rdp->cblist) < thresh ||
+	    !ron || !rcl->head)
+		return false;
+	ron += cpu_to_node(rdp->cpu);
+	if (!ron->kthread)
+		return false;
+
+	for (rhp = rcl->head; rhp; rhp = rhp->next) {
+		n++;
+		if (__is_kfree_rcu_offset((unsigned long)rhp->func))
+			n_lazy++;
+	}
+
+	raw_spin_lock_irqsave(&ron->lock, flags);
+	*ron->tail = rcl->head;
+	ron->tail = rcl->tail;
+	ron->n_queued += n;
+	raw_spin_unlock_irqrestore(&ron->lock, flags);
+	swake_up(&ron->wq);
+
+	rcl->head = NULL;
+	rcl->tail = &rcl->head;
+	rcl->len -= n;
+	rcl->len_lazy -= n_lazy;
+	rdp->n_cbs_offloaded += n;
+	return true;
+}
+
+/*
+ * Per-node kthread invoking the callbacks handed off by rcu_offload_cbs().
+ * The callbacks expect to run with bottom halves disabled, as they would
+ * in softirq context.
+ */
+static int rcu_offload_kthread(void *arg)
+{
+	struct rcu_offload_node *ron = arg;
+	struct rcu_head *rhp, *next;
+	unsigned long n;
+
+	for (;;) {
+		swait_event_interruptible(ron->wq, READ_ONCE(ron->head));
+		raw_spin_lock_irq(&ron->lock);
+		rhp = ron->head;
+		ron->head = NULL;
+		ron->tail = &ron->head;
+		raw_spin_unlock_irq(&ron->lock);
+
+		for (n = 0; rhp; rhp = next, n++) {
+			next = rhp->next;
+			debug_rcu_head_unqueue(rhp);
+			local_bh_disable();
+			__rcu_reclaim("rcuo_node", rhp);
+			local_bh_enable();
+			cond_resched_rcu_qs();
+		}
+
+		/* Invocations before count, for rcu_offload_barrier(). */
+		smp_store_release(&ron->n_invoked, ron->n_invoked + n);
+		swake_up_all(&ron->drain_wq);
+	}
+	return 0;
+}
+
+/*
+ * Wait for the rcuo_node kthreads to invoke all the callbacks handed to
+ * them so far.  rcu_barrier() needs this, as those callbacks are no longer
+ * on any CPU's list by the time its own callback is invoked.
+ */
+static void rcu_offload_barrier(void)
+{
+	struct rcu_offload_node *ron, *nodes = READ_ONCE(rcu_offload_nodes);
+	unsigned long snap;
+	int node;
+
+	if (!nodes)
+		return;
+	for_each_node(node) {
+		ron = &nodes[node];
+		raw_spin_lock_irq(&ron->lock);
+		snap = ron->n_queued;
+		raw_spin_unlock_irq(&ron->lock);
+		swait_event(ron->drain_wq,
+			    ULONG_CMP_GE(smp_load_acquire(&ron->n_invoked), snap));
+	}
+}
+
+/*
+ * Spawn one rcuo_node kthread for each NUMA node that has CPUs.  Nodes
+ * without one (for example, hotplugged later) invoke callbacks locally.
+ */
+static void __init rcu_spawn_offload_kthreads(void)
+{
+	struct rcu_offload_node *nodes;
+	struct task_struct *t;
+	int node;
+
+	nodes = kcalloc(nr_node_ids, sizeof(*nodes), GFP_KERNEL);
+	if (WARN_ON_ONCE(!nodes))
+		return;
+	for (node = 0; node < nr_node_ids; node++) {
+		raw_spin_lock_init(&nodes[node].lock);
+		nodes[node].tail = &nodes[node].head;
+		init_swait_queue_head(&nodes[node].wq);
+		init_swait_queue_head(&nodes[node].drain_wq);
+	}
+	for_each_node_with_cpus(node) {
+		t = kthread_create_on_node(rcu_offload_kthread, &nodes[node],
+					   node, "rcuo_node/%d", node);
+		if (WARN_ON_ONCE(IS_ERR(t)))
+			continue;
+		set_cpus_allowed_ptr(t, cpumask_of_node(node));
+		nodes[node].kthread = t;
+		wake_up_process(t);
+	}
+	smp_store_release(&rcu_offload_nodes, nodes); /* Init before use. */
+}
+
 /*
  * Invoke any RCU callbacks that have made it to the end of their grace
  * period.  Thottle as specified by rdp->blimit.
@@ -2793,8 +2965,11 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 	rcu_segcblist_extract_done_cbs(&rdp->cblist, &rcl);
 	local_irq_restore(flags);
 
-	/* Invoke callbacks. */
-	rhp = rcu_cblist_dequeue(&rcl);
+	/* Invoke callbacks, unless rcuo_node is to take care of them. */
+	if (rcu_offload_cbs(rdp, &rcl))
+		rhp = NULL;
+	else
+		rhp = rcu_cblist_dequeue(&rcl);
 	for (; rhp; rhp = rcu_cblist_dequeue(&rcl)) {
 		debug_rcu_head_unqueue(rhp);
 		if (__rcu_reclaim(rsp->name, rhp))
@@ -3134,10 +3309,11 @@ static void rcu_leak_callback(struct rcu_head *rhp)
  */
 static void
 __call_rcu(struct rcu_head *head, rcu_callback_t func,
-	   struct rcu_state *rsp, int cpu, bool lazy)
+	   struct rcu_state *rsp, int cpu, bool lazy, bool defer)
 {
 	unsigned long flags;
 	struct rcu_data *rdp;
+	bool pend_empty;
 
 	/* Misaligned rcu_head! */
 	WARN_ON_ONCE((unsigned long)head & (sizeof(void *) - 1));
@@ -3176,10 +3352,19 @@ __call_rcu(struct rcu_head *head, rcu_callback_t func,
 		if (rcu_segcblist_empty(&rdp->cblist))
 			rcu_segcblist_init(&rdp->cblist);
 	}
+	pend_empty = !rcu_segcblist_pend_cbs(&rdp->cblist);
 	rcu_segcblist_enqueue(&rdp->cblist, head, lazy);
 	if (!lazy)
 		rcu_idle_count_callbacks_posted();
 
+	/* Can the grace period be deferred?  See rcu_lazy_defer(). */
+	if (pend_empty) {
+		rdp->lazy_only = defer;
+		rdp->lazy_start = jiffies;
+	} else if (!defer) {
+		rdp->lazy_only = false;
+	}
+
 	if (__is_kfree_rcu_offset((unsigned long)func))
 		trace_rcu_kfree_callback(rsp->name, head, (unsigned long)func,
 					 rcu_segcblist_n_lazy_cbs(&rdp->cblist),
@@ -3199,7 +3384,7 @@ __call_rcu(struct rcu_head *head, rcu_callback_t func,
  */
 void call_rcu_sched(struct rcu_head *head, rcu_callback_t func)
 {
-	__call_rcu(head, func, &rcu_sched_state, -1, 0);
+	__call_rcu(head, func, &rcu_sched_state, -1, 0, 0);
 }
 EXPORT_SYMBOL_GPL(call_rcu_sched);
 
@@ -3208,24 +3393,40 @@ EXPORT_SYMBOL_GPL(call_rcu_sched);
  */
 void call_rcu_bh(struct rcu_head *head, rcu_callback_t func)
 {
-	__call_rcu(head, func, &rcu_bh_state, -1, 0);
+	__call_rcu(head, func, &rcu_bh_state, -1, 0, 0);
 }
 EXPORT_SYMBOL_GPL(call_rcu_bh);
 
 /*
  * Queue an RCU callback for lazy invocation after a grace period.
- * This will likely be later named something like "call_rcu_lazy()",
- * but this change will require some way of tagging the lazy RCU
- * callbacks in the list of pending callbacks. Until then, this
- * function may only be called from __kfree_rcu().
+ * The lazy callback counts assume that this is a kfree() offset rather
+ * than a function, so this may only be called from __kfree_rcu().
+ * Other callbacks that are in no hurry should use call_rcu_lazy().
  */
 void kfree_call_rcu(struct rcu_head *head,
 		    rcu_callback_t func)
 {
-	__call_rcu(head, func, rcu_state_p, -1, 1);
+	__call_rcu(head, func, rcu_state_p, -1, 1, 1);
 }
 EXPORT_SYMBOL_GPL(kfree_call_rcu);
 
+/**
+ * call_rcu_lazy() - Queue an RCU callback that is in no hurry.
+ * @head: structure to be used for queueing the RCU updates.
+ * @func: actual callback function to be invoked after the grace period
+ *
+ * Like call_rcu(), but the caller does not mind the grace period
+ * being delayed by up to rcutree.lazy_jiffies, so that bursts of such
+ * callbacks (typically ones freeing memory) can share a grace period.
+ * Unlike kfree_rcu() callbacks, these are not considered lazy for the
+ * purposes of RCU_FAST_NO_HZ.
+ */
+void call_rcu_lazy(struct rcu_head *head, rcu_callback_t func)
+{
+	__call_rcu(head, func, rcu_state_p, -1, 0, 1);
+}
+EXPORT_SYMBOL_GPL(call_rcu_lazy);
+
 /*
  * Because a context switch is a grace period for RCU-sched and RCU-bh,
  * any blocking grace-period wait automatically implies a grace period
@@ -3381,6 +3582,67 @@ void cond_synchronize_rcu(unsigned long oldstate)
 }
 EXPORT_SYMBOL_GPL(cond_synchronize_rcu);
 
+/*
+ * Make sure that a grace period will start that satisfies a cookie
+ * just obtained from get_state_synchronize_rcu() or friends, so that
+ * polling for it succeeds even if nobody else needs a grace period.
+ */
+static void rcu_poll_start_gp(struct rcu_state *rsp)
+{
+	unsigned long flags;
+	struct rcu_data *rdp;
+	struct rcu_node *rnp;
+	bool needwake;
+
+	local_irq_save(flags);
+	rdp = this_cpu_ptr(rsp->rda);
+	rnp = rdp->mynode;
+	raw_spin_lock_rcu_node(rnp); /* irqs already disabled. */
+	needwake = rcu_start_future_gp(rnp, rdp, NULL);
+	raw_spin_unlock_irqrestore_rcu_node(rnp, flags);
+	if (needwake)
+		rcu_gp_kthread_wake(rsp);
+}
+
+/**
+ * start_poll_synchronize_rcu - Snapshot RCU state and start a grace period
+ *
+ * Returns a cookie like get_state_synchronize_rcu(), but also makes sure
+ * that a grace period satisfying it gets started.  The cookie can then be
+ * checked with poll_state_synchronize_rcu(), so that objects whose grace
+ * period has already elapsed can be reused at once, without waiting and
+ * without queueing a callback for each of them.
+ */
+unsigned long start_poll_synchronize_rcu(void)
+{
+	unsigned long oldstate = get_state_synchronize_rcu();
+
+	rcu_poll_start_gp(rcu_state_p);
+	return oldstate;
+}
+EXPORT_SYMBOL_GPL(start_poll_synchronize_rcu);
+
+/**
+ * poll_state_synchronize_rcu - Has an RCU grace period elapsed?
+ *
+ * @oldstate: return value from earlier call to get_state_synchronize_rcu()
+ *	      or start_poll_synchronize_rcu()
+ *
+ * Returns true if a full RCU grace period has elapsed since the call
+ * that returned @oldstate, without ever blocking.  The same counter-wrap
+ * caveats as for cond_synchronize_rcu() apply.
+ */
+bool poll_state_synchronize_rcu(unsigned long oldstate)
+{
+	/*
+	 * Ensure that this load happens before any RCU-destructive
+	 * actions the caller might carry out after we return.
+	 */
+	return ULONG_CMP_LT(oldstate,
+			    smp_load_acquire(&rcu_state_p->completed));
+}
+EXPORT_SYMBOL_GPL(poll_state_synchronize_rcu);
+
 /**
  * get_state_synchronize_sched - Snapshot current RCU-sched state
  *
@@ -3433,6 +3695,35 @@ void cond_synchronize_sched(unsigned long oldstate)
 }
 EXPORT_SYMBOL_GPL(cond_synchronize_sched);
 
+/**
+ * start_poll_synchronize_sched - Snapshot RCU-sched state, start a GP
+ *
+ * The RCU-sched counterpart of start_poll_synchronize_rcu().
+ */
+unsigned long start_poll_synchronize_sched(void)
+{
+	unsigned long oldstate = get_state_synchronize_sched();
+
+	rcu_poll_start_gp(&rcu_sched_state);
+	return oldstate;
+}
+EXPORT_SYMBOL_GPL(start_poll_synchronize_sched);
+
+/**
+ * poll_state_synchronize_sched - Has an RCU-sched grace period elapsed?
+ *
+ * @oldstate: return value from earlier call to get_state_synchronize_sched()
+ *	      or start_poll_synchronize_sched()
+ *
+ * The RCU-sched counterpart of poll_state_synchronize_rcu().
+ */
+bool poll_state_synchronize_sched(unsigned long oldstate)
+{
+	return ULONG_CMP_LT(oldstate,
+			    smp_load_acquire(&rcu_sched_state.completed));
+}
+EXPORT_SYMBOL_GPL(poll_state_synchronize_sched);
+
 /*
  * Check to see if there is any immediate RCU-related work to be done
  * by the current CPU, for the specified type of RCU, returning 1 if so.
@@ -3638,7 +3929,7 @@ static void _rcu_barrier(struct rcu_state *rsp)
 				smp_mb__before_atomic();
 				atomic_inc(&rsp->barrier_cpu_count);
 				__call_rcu(&rdp->barrier_head,
-					   rcu_barrier_callback, rsp, cpu, 0);
+					   rcu_barrier_callback, rsp, cpu, 0, 0);
 			}
 		} else if (rcu_segcblist_n_cbs(&rdp->cblist)) {
 			_rcu_barrier_trace(rsp, "OnlineQ", cpu,
@@ -3661,6 +3952,9 @@ static void _rcu_barrier(struct rcu_state *rsp)
 	/* Wait for all rcu_barrier_callback() callbacks to be invoked. */
 	wait_for_completion(&rsp->barrier_completion);
 
+	/* Also wait for callbacks handed off to the rcuo_node kthreads. */
+	rcu_offload_barrier();
+
 	/* Mark the end of the barrier operation. */
 	_rcu_barrier_trace(rsp, "Inc2", -1, rsp->barrier_sequence);
 	rcu_seq_end(&rsp->barrier_sequence);
@@ -3989,6 +4283,7 @@ static int __init rcu_spawn_gp_kthread(void)
 	}
 	rcu_spawn_nocb_kthreads();
 	rcu_spawn_boost_kthreads();
+	rcu_spawn_offload_kthreads();
 	return 0;
 }
 early_initcall(rcu_spawn_gp_kthread);
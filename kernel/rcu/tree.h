@@ -242,9 +242,12 @@ struct rcu_data {
 	unsigned long	n_nocbs_invoked; /* count of no-CBs RCU cbs invoked. */
 	unsigned long   n_cbs_orphaned; /* RCU cbs orphaned by dying CPU */
 	unsigned long   n_cbs_adopted;  /* RCU cbs adopted from dying CPU */
+	unsigned long	n_cbs_offloaded; /* RCU cbs handed to rcuo_node. */
 	unsigned long	n_force_qs_snap;
 					/* did other CPU force QS recently? */
 	long		blimit;		/* Upper limit on a processed batch */
+	bool		lazy_only;	/* Pending CBs all lazy? */
+	unsigned long	lazy_start;	/* When the oldest of those was queued. */
 
 	/* 3) dynticks interface. */
 	struct rcu_dynticks *dynticks;	/* Shared per-CPU dynticks state. */
@@ -339,6 +342,22 @@ do {									\
 	__set_current_state(TASK_RUNNING);				\
 } while (0)
 
+/*
+ * Per-NUMA-node queue of ready-to-invoke callbacks that rcu_do_batch()
+ * handed off instead of invoking them in softirq context, along with
+ * the rcuo_node kthread that invokes them.  Shared by all flavors.
+ */
+struct rcu_offload_node {
+	raw_spinlock_t lock;		/* Protects ->head, ->tail, ->n_queued. */
+	struct rcu_head *head;		/* Callbacks awaiting invocation. */
+	struct rcu_head **tail;
+	unsigned long n_queued;		/* Total callbacks ever queued. */
+	unsigned long n_invoked;	/* Total callbacks ever invoked. */
+	struct swait_queue_head wq;	/* rcuo_node kthread waits here. */
+	struct swait_queue_head drain_wq; /* rcu_barrier() waits here. */
+	struct task_struct *kthread;
+};
+
 /*
  * RCU global state, including node hierarchy.  This hierarchy is
  * represented in "heap" form in a dense array.  The root (first level)
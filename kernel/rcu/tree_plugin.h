@@ -648,7 +648,7 @@ static void rcu_preempt_do_callbacks(void)
  */
 void call_rcu(struct rcu_head *head, rcu_callback_t func)
 {
-	__call_rcu(head, func, rcu_state_p, -1, 0);
+	__call_rcu(head, func, rcu_state_p, -1, 0, 0);
 }
 EXPORT_SYMBOL_GPL(call_rcu);
 
@@ -147,9 +147,10 @@ static void print_one_rcu_data(struct seq_file *m, struct rcu_data *rdp)
 		   per_cpu(rcu_cpu_kthread_loops, rdp->cpu) & 0xffff);
 #endif /* #ifdef CONFIG_RCU_BOOST */
 	seq_printf(m, " b=%ld", rdp->blimit);
-	seq_printf(m, " ci=%lu nci=%lu co=%lu ca=%lu\n",
+	seq_printf(m, " ci=%lu nci=%lu co=%lu ca=%lu cof=%lu\n",
 		   rdp->n_cbs_invoked, rdp->n_nocbs_invoked,
-		   rdp->n_cbs_orphaned, rdp->n_cbs_adopted);
+		   rdp->n_cbs_orphaned, rdp->n_cbs_adopted,
+		   rdp->n_cbs_offloaded);
 }
 
 static int show_rcudata(struct seq_file *m, void *v)
@@ -449,7 +449,12 @@ void wake_q_add(struct wake_q_head *head, struct task_struct *task)
 void wake_up_q(struct wake_q_head *head)
 {
 	struct wake_q_node *node = head->first;
+	bool batch;
 
+	if (node == WAKE_Q_TAIL)
+		return;
+
+	batch = ttwu_batch_begin();
 	while (node != WAKE_Q_TAIL) {
 		struct task_struct *task;
 
@@ -466,6 +471,7 @@ void wake_up_q(struct wake_q_head *head)
 		wake_up_process(task);
 		put_task_struct(task);
 	}
+	ttwu_batch_end(batch);
 }
 
 /*
@@ -750,6 +756,233 @@ static void set_load_weight(struct task_struct *p)
 	load->inv_weight = sched_prio_to_wmult[prio];
 }
 
+#ifdef CONFIG_UCLAMP_TASK
+/*
+ * Utilization clamping: the clamp values of a task, as requested through
+ * sched_setattr() and restricted to its task group's range, are accounted
+ * in the rq while it is RUNNABLE.  The rq's clamp values are the highest
+ * ones of its tasks (max aggregation), so that a boosted task gets its
+ * boost and a task is only capped when all the others agree.  schedutil
+ * clamps the CPU utilization with them, see uclamp_util().
+ */
+static DEFINE_MUTEX(uclamp_mutex);
+
+static inline unsigned int uclamp_none(enum uclamp_id clamp_id)
+{
+	if (clamp_id == UCLAMP_MIN)
+		return 0;
+	return SCHED_CAPACITY_SCALE;
+}
+
+static inline unsigned int uclamp_bucket_id(unsigned int value)
+{
+	return min_t(unsigned int, value / UCLAMP_BUCKET_DELTA,
+		     UCLAMP_BUCKETS - 1);
+}
+
+static unsigned int uclamp_eff_value(struct task_struct *p,
+				     enum uclamp_id clamp_id)
+{
+	unsigned int value = p->uclamp_req[clamp_id];
+#ifdef CONFIG_CGROUP_SCHED
+	struct task_group *tg = task_group(p);
+
+	value = clamp(value, READ_ONCE(tg->uclamp_eff[UCLAMP_MIN]),
+		      READ_ONCE(tg->uclamp_eff[UCLAMP_MAX]));
+#endif
+
+	return value;
+}
+
+#ifdef CONFIG_CGROUP_SCHED
+/*
+ * A group can only narrow the range of its parent: its effective clamps
+ * are its own requests capped by the parent's effective ones.  Called
+ * with uclamp_mutex held, parents before children.
+ */
+static void uclamp_update_tg_eff(struct task_group *tg)
+{
+	unsigned int eff[UCLAMP_CNT];
+	enum uclamp_id clamp_id;
+
+	lockdep_assert_held(&uclamp_mutex);
+
+	for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++) {
+		eff[clamp_id] = tg->uclamp_req[clamp_id];
+		if (tg->parent)
+			eff[clamp_id] = min(eff[clamp_id],
+					    tg->parent->uclamp_eff[clamp_id]);
+	}
+	/* A boost is always capped by the limit */
+	eff[UCLAMP_MIN] = min(eff[UCLAMP_MIN], eff[UCLAMP_MAX]);
+
+	for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++)
+		WRITE_ONCE(tg->uclamp_eff[clamp_id], eff[clamp_id]);
+}
+#endif
+
+static inline void uclamp_rq_inc_id(struct rq *rq, struct task_struct *p,
+				    enum uclamp_id clamp_id)
+{
+	struct uclamp_rq *uc_rq = &rq->uclamp[clamp_id];
+	struct uclamp_se *uc_se = &p->uclamp[clamp_id];
+	struct uclamp_bucket *bucket;
+
+	uc_se->value = uclamp_eff_value(p, clamp_id);
+	uc_se->bucket_id = uclamp_bucket_id(uc_se->value);
+
+	bucket = &uc_rq->bucket[uc_se->bucket_id];
+	if (!bucket->tasks++ || uc_se->value > bucket->value)
+		bucket->value = uc_se->value;
+
+	if (!uc_rq->nr_tasks++ || uc_se->value > uc_rq->value)
+		WRITE_ONCE(uc_rq->value, uc_se->value);
+}
+
+static inline void uclamp_rq_dec_id(struct rq *rq, struct task_struct *p,
+				    enum uclamp_id clamp_id)
+{
+	struct uclamp_rq *uc_rq = &rq->uclamp[clamp_id];
+	struct uclamp_se *uc_se = &p->uclamp[clamp_id];
+	struct uclamp_bucket *bucket = &uc_rq->bucket[uc_se->bucket_id];
+	unsigned int value = uclamp_none(clamp_id);
+	int i;
+
+	SCHED_WARN_ON(!bucket->tasks || !uc_rq->nr_tasks);
+	uc_rq->nr_tasks--;
+
+	/*
+	 * The bucket keeps its max clamp value until it is empty; that
+	 * overestimates the clamp at most by the bucket width.
+	 */
+	if (--bucket->tasks || uc_se->value < uc_rq->value)
+		return;
+
+	for (i = UCLAMP_BUCKETS - 1; i >= 0; i--) {
+		if (uc_rq->bucket[i].tasks) {
+			value = uc_rq->bucket[i].value;
+			break;
+		}
+	}
+	WRITE_ONCE(uc_rq->value, value);
+}
+
+static inline void uclamp_rq_inc(struct rq *rq, struct task_struct *p)
+{
+	enum uclamp_id clamp_id;
+
+	for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++)
+		uclamp_rq_inc_id(rq, p, clamp_id);
+}
+
+static inline void uclamp_rq_dec(struct rq *rq, struct task_struct *p)
+{
+	enum uclamp_id clamp_id;
+
+	for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++)
+		uclamp_rq_dec_id(rq, p, clamp_id);
+}
+
+/* Re-evaluate the clamps of @p, e.g. after its task group's changed. */
+static void uclamp_update_active(struct task_struct *p)
+{
+	struct rq_flags rf;
+	struct rq *rq;
+
+	rq = task_rq_lock(p, &rf);
+	if (task_on_rq_queued(p)) {
+		uclamp_rq_dec(rq, p);
+		uclamp_rq_inc(rq, p);
+	}
+	task_rq_unlock(rq, p, &rf);
+}
+
+static int uclamp_validate(struct task_struct *p,
+			   const struct sched_attr *attr)
+{
+	unsigned int lower = p->uclamp_req[UCLAMP_MIN];
+	unsigned int upper = p->uclamp_req[UCLAMP_MAX];
+
+	if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP_MIN)
+		lower = attr->sched_util_min;
+	if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP_MAX)
+		upper = attr->sched_util_max;
+
+	if (lower > upper || upper > SCHED_CAPACITY_SCALE)
+		return -EINVAL;
+
+	return 0;
+}
+
+static bool uclamp_changed(struct task_struct *p,
+			   const struct sched_attr *attr)
+{
+	if ((attr->sched_flags & SCHED_FLAG_UTIL_CLAMP_MIN) &&
+	    attr->sched_util_min != p->uclamp_req[UCLAMP_MIN])
+		return true;
+	if ((attr->sched_flags & SCHED_FLAG_UTIL_CLAMP_MAX) &&
+	    attr->sched_util_max != p->uclamp_req[UCLAMP_MAX])
+		return true;
+
+	return false;
+}
+
+static void __setscheduler_uclamp(struct task_struct *p,
+				  const struct sched_attr *attr)
+{
+	if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP_MIN)
+		p->uclamp_req[UCLAMP_MIN] = attr->sched_util_min;
+	if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP_MAX)
+		p->uclamp_req[UCLAMP_MAX] = attr->sched_util_max;
+}
+
+static void uclamp_fork(struct task_struct *p)
+{
+	if (likely(!p->sched_reset_on_fork))
+		return;
+
+	p->uclamp_req[UCLAMP_MIN] = uclamp_none(UCLAMP_MIN);
+	p->uclamp_req[UCLAMP_MAX] = uclamp_none(UCLAMP_MAX);
+}
+
+static void __init init_uclamp(void)
+{
+	enum uclamp_id clamp_id;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++)
+			cpu_rq(cpu)->uclamp[clamp_id].value = uclamp_none(clamp_id);
+	}
+
+	for (clamp_id = 0; clamp_id < UCLAMP_CNT; clamp_id++) {
+		init_task.uclamp_req[clamp_id] = uclamp_none(clamp_id);
+#ifdef CONFIG_CGROUP_SCHED
+		root_task_group.uclamp_req[clamp_id] = uclamp_none(clamp_id);
+		root_task_group.uclamp_eff[clamp_id] = uclamp_none(clamp_id);
+#endif
+	}
+}
+
+#else /* CONFIG_UCLAMP_TASK */
+static inline void uclamp_rq_inc(struct rq *rq, struct task_struct *p) { }
+static inline void uclamp_rq_dec(struct rq *rq, struct task_struct *p) { }
+static inline int uclamp_validate(struct task_struct *p,
+				  const struct sched_attr *attr)
+{
+	return -EOPNOTSUPP;
+}
+static inline bool uclamp_changed(struct task_struct *p,
+				  const struct sched_attr *attr)
+{
+	return false;
+}
+static inline void __setscheduler_uclamp(struct task_struct *p,
+					 const struct sched_attr *attr) { }
+static inline void uclamp_fork(struct task_struct *p) { }
+static inline void init_uclamp(void) { }
+#endif /* CONFIG_UCLAMP_TASK */
+
 static inline void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	if (!(flags & ENQUEUE_NOCLOCK))
@@ -758,6 +991,7 @@ static inline void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 	if (!(flags & ENQUEUE_RESTORE))
 		sched_info_queued(rq, p);
 
+	uclamp_rq_inc(rq, p);
 	p->sched_class->enqueue_task(rq, p, flags);
 }
 
@@ -769,6 +1003,7 @@ static inline void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
 	if (!(flags & DEQUEUE_SAVE))
 		sched_info_dequeued(rq, p);
 
+	uclamp_rq_dec(rq, p);
 	p->sched_class->dequeue_task(rq, p, flags);
 }
 
@@ -1755,6 +1990,21 @@ void sched_ttwu_pending(void)
 	rq_unlock_irqrestore(rq, &rf);
 }
 
+#ifdef CONFIG_SCHED_CORE
+/* A sibling took the core for a conflicting cookie, see sched_core_pick() */
+static inline void sched_core_ipi(struct rq *rq)
+{
+	if (!READ_ONCE(rq->core_kick))
+		return;
+
+	WRITE_ONCE(rq->core_kick, false);
+	set_tsk_need_resched(current);
+	set_preempt_need_resched();
+}
+#else
+static inline void sched_core_ipi(struct rq *rq) { }
+#endif
+
 void scheduler_ipi(void)
 {
 	/*
@@ -1763,6 +2013,7 @@ void scheduler_ipi(void)
 	 * this IPI.
 	 */
 	preempt_fold_need_resched();
+	sched_core_ipi(this_rq());
 
 	if (llist_empty(&this_rq()->wake_list) && !got_nohz_idle_kick())
 		return;
@@ -1793,18 +2044,103 @@ void scheduler_ipi(void)
 	irq_exit();
 }
 
+/*
+ * Remote wakeup batching.
+ *
+ * Between ttwu_batch_begin() and ttwu_batch_end() the reschedule IPIs that
+ * ttwu_queue_remote() would send are collected in a per-cpu mask instead,
+ * and sent in one go when the outermost batch ends. Targets that already
+ * have a pending wake_list need no IPI at all, so every target CPU gets at
+ * most one IPI per batch, and an architecture that can multicast IPIs
+ * (see smp_send_reschedule_mask()) can kick all of them with a single
+ * message.
+ *
+ * Preemption stays disabled for the duration of the batch, which keeps the
+ * deferral window short and bounded, and holds off CPU hot-unplug of the
+ * targets until their IPI has gone out. Interrupts that wake tasks while a
+ * batch is open simply add to it.
+ *
+ * ttwu_batch_begin() returns false, and the batch costs nothing, when the
+ * TTWU_BATCH feature is off; its result must be passed to ttwu_batch_end().
+ * A batch that deferred no IPI ends without touching the mask.
+ */
+static DEFINE_PER_CPU(unsigned int, ttwu_batch_depth);
+static DEFINE_PER_CPU(bool, ttwu_batch_pending);
+DEFINE_PER_CPU(cpumask_var_t, ttwu_ipi_mask);
+
+bool ttwu_batch_begin(void)
+{
+	if (!sched_feat(TTWU_BATCH))
+		return false;
+
+	preempt_disable();
+	this_cpu_inc(ttwu_batch_depth);
+	return true;
+}
+
+void ttwu_batch_end(bool batch)
+{
+	struct cpumask *mask;
+	unsigned long flags;
+	unsigned int nr;
+
+	if (!batch)
+		return;
+
+	if (this_cpu_dec_return(ttwu_batch_depth) ||
+	    !this_cpu_read(ttwu_batch_pending)) {
+		preempt_enable();
+		return;
+	}
+
+	local_irq_save(flags);
+	this_cpu_write(ttwu_batch_pending, false);
+
+	mask = this_cpu_cpumask_var_ptr(ttwu_ipi_mask);
+	nr = cpumask_weight(mask);
+	if (!nr)
+		goto out;
+
+	if (nr == 1) {
+		smp_send_reschedule(cpumask_first(mask));
+		schedstat_inc(this_rq()->ttwu_ipi_sent);
+	} else {
+		smp_send_reschedule_mask(mask);
+		schedstat_inc(this_rq()->ttwu_ipi_mask_sent);
+		schedstat_add(this_rq()->ttwu_ipi_mask_cpus, nr);
+	}
+	cpumask_clear(mask);
+out:
+	local_irq_restore(flags);
+	preempt_enable();
+}
+
 static void ttwu_queue_remote(struct task_struct *p, int cpu, int wake_flags)
 {
 	struct rq *rq = cpu_rq(cpu);
 
 	p->sched_remote_wakeup = !!(wake_flags & WF_MIGRATED);
 
-	if (llist_add(&p->wake_entry, &cpu_rq(cpu)->wake_list)) {
-		if (!set_nr_if_polling(rq->idle))
-			smp_send_reschedule(cpu);
-		else
-			trace_sched_wake_idle_without_ipi(cpu);
+	if (!llist_add(&p->wake_entry, &cpu_rq(cpu)->wake_list)) {
+		/* An IPI is already on its way (or deferred) for this list. */
+		schedstat_inc(this_rq()->ttwu_ipi_coalesced);
+		return;
+	}
+
+	if (set_nr_if_polling(rq->idle)) {
+		trace_sched_wake_idle_without_ipi(cpu);
+		schedstat_inc(this_rq()->ttwu_ipi_polling);
+		return;
 	}
+
+	if (this_cpu_read(ttwu_batch_depth)) {
+		cpumask_set_cpu(cpu, this_cpu_cpumask_var_ptr(ttwu_ipi_mask));
+		this_cpu_write(ttwu_batch_pending, true);
+		return;
+	}
+
+	smp_send_reschedule(cpu);
+	schedstat_inc(this_rq()->ttwu_ipi_sent);
 }
 
 void wake_up_if_idle(int cpu)
@@ -2221,6 +2557,7 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 	p->numa_scan_period = sysctl_numa_balancing_scan_delay;
 	p->numa_work.next = &p->numa_work;
 	p->numa_faults = NULL;
+	p->numa_sampled_migrated = NULL;
 	p->last_task_numa_placement = 0;
 	p->last_sum_exec_runtime = 0;
 
@@ -2372,9 +2709,13 @@ int sched_fork(unsigned long clone_flags, struct task_struct *p)
 		} else if (PRIO_TO_NICE(p->static_prio) < 0)
 			p->static_prio = NICE_TO_PRIO(0);
 
+		p->latency_nice = DEFAULT_LATENCY_NICE;
+
 		p->prio = p->normal_prio = __normal_prio(p);
 		set_load_weight(p);
 
+		uclamp_fork(p);
+
 		/*
 		 * We don't need the reset flag anymore after the fork. It has
 		 * fulfilled its duty:
@@ -3085,6 +3426,304 @@ unsigned long long task_sched_runtime(struct task_struct *p)
 	return ns;
 }
 
+#ifdef CONFIG_SCHED_CORE
+
+/*
+ * Core scheduling: tasks of tagged cgroups carry a cookie, and SMT siblings
+ * only run tasks with equal cookies at the same time; the idle task goes
+ * with anything.  Every rq publishes the cookie of the task it runs (or is
+ * about to switch to); a CPU that picks a task conflicting with a sibling
+ * switches to idle instead ("forced idle") until the sibling moves on and
+ * kicks it.  A sibling kept forced idle for longer than sched_latency makes
+ * the running CPU yield the core on its next tick.
+ *
+ * The stopper and untagged kernel threads are never forced idle and never
+ * yield: they win the core outright, and siblings running a conflicting
+ * cookie are kicked into picking again right away.  Every other class,
+ * RT and deadline included, plays by the cookie rules.
+ */
+DEFINE_STATIC_KEY_FALSE(__sched_core_enabled);
+static DEFINE_MUTEX(sched_core_mutex);
+static unsigned int sched_core_count;
+
+enum {
+	CORE_IDLE,		/* running idle, compatible with anything */
+	CORE_PENDING,		/* about to run ->core_cookie, checking siblings */
+	CORE_RUNNING,		/* running ->core_cookie */
+};
+
+/*
+ * Does running @cookie on @rq conflict with any of its SMT siblings? Two
+ * siblings picking conflicting cookies at the same time are resolved in
+ * favour of the lower CPU: the higher one backs off, the lower one waits
+ * for it to do so.
+ */
+static bool sched_core_conflict(struct rq *rq, unsigned long cookie)
+{
+	int cpu = cpu_of(rq), i;
+
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+		unsigned long scookie;
+		unsigned int state;
+
+		if (i == cpu)
+			continue;
+again:
+		state = READ_ONCE(srq->core_state);
+		smp_rmb();
+		scookie = READ_ONCE(srq->core_cookie);
+		smp_rmb();
+		if (READ_ONCE(srq->core_state) != state)
+			goto again;
+
+		if (state == CORE_IDLE || scookie == cookie)
+			continue;
+		if (state == CORE_RUNNING || i < cpu)
+			return true;
+
+		while (READ_ONCE(srq->core_state) == CORE_PENDING)
+			cpu_relax();
+		goto again;
+	}
+
+	return false;
+}
+
+/*
+ * Should @rq give up the core because a sibling has been kept forced idle
+ * for too long by a cookie other than its own?
+ */
+static bool sched_core_should_yield(struct rq *rq, unsigned long cookie)
+{
+	int cpu = cpu_of(rq), i;
+
+	if (!rq->core_yield)
+		return false;
+
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+
+		if (i != cpu && READ_ONCE(srq->core_forceidle) &&
+		    READ_ONCE(srq->core_wait_cookie) != cookie)
+			return true;
+	}
+
+	rq->core_yield = false;
+	return false;
+}
+
+/* Make forced idle siblings pick again, without taking their rq lock. */
+static void sched_core_kick_forceidle(struct rq *rq)
+{
+	int cpu = cpu_of(rq), i;
+
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+
+		if (i == cpu || !READ_ONCE(srq->core_forceidle))
+			continue;
+		if (set_nr_and_not_polling(srq->idle))
+			smp_send_reschedule(i);
+	}
+}
+
+/*
+ * Make siblings running a cookie other than @cookie pick again.  Their rq
+ * lock nests badly with ours, so flag them and let scheduler_ipi() set
+ * need_resched locally; exempt siblings are left alone.
+ */
+static void sched_core_kick_conflicting(struct rq *rq, unsigned long cookie)
+{
+	int cpu = cpu_of(rq), i;
+
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+
+		if (i == cpu || READ_ONCE(srq->core_exempt) ||
+		    READ_ONCE(srq->core_state) != CORE_RUNNING ||
+		    READ_ONCE(srq->core_cookie) == cookie)
+			continue;
+
+		WRITE_ONCE(srq->core_kick, true);
+		smp_send_reschedule(i);
+	}
+}
+
+static void sched_core_forceidle_end(struct rq *rq)
+{
+	if (!rq->core_forceidle)
+		return;
+
+	schedstat_add(rq->core_forceidle_time,
+		      rq_clock(rq) - rq->core_forceidle_start);
+	WRITE_ONCE(rq->core_forceidle, false);
+}
+
+/* The stopper and untagged kernel threads are exempt from forced idle. */
+static inline bool sched_core_exempt(struct task_struct *p)
+{
+	return p->sched_class == &stop_sched_class ||
+	       (!p->core_cookie && (p->flags & PF_KTHREAD));
+}
+
+static struct task_struct *
+sched_core_pick(struct rq *rq, struct task_struct *next, struct rq_flags *rf)
+{
+	unsigned int prev_state = rq->core_state;
+	unsigned long cookie;
+
+	if (next == rq->idle) {
+		sched_core_forceidle_end(rq);
+		WRITE_ONCE(rq->core_exempt, false);
+		if (prev_state != CORE_IDLE) {
+			WRITE_ONCE(rq->core_state, CORE_IDLE);
+			smp_mb();
+			sched_core_kick_forceidle(rq);
+		}
+		return next;
+	}
+
+	cookie = next->core_cookie;
+
+	if (sched_core_exempt(next)) {
+		WRITE_ONCE(rq->core_state, CORE_PENDING);
+		smp_wmb();
+		WRITE_ONCE(rq->core_cookie, cookie);
+		WRITE_ONCE(rq->core_exempt, true);
+		smp_wmb();
+		WRITE_ONCE(rq->core_state, CORE_RUNNING);
+		rq->core_yield = false;
+		sched_core_forceidle_end(rq);
+		smp_mb();
+		sched_core_kick_forceidle(rq);
+		sched_core_kick_conflicting(rq, cookie);
+		return next;
+	}
+
+	WRITE_ONCE(rq->core_exempt, false);
+	if (prev_state == CORE_RUNNING && rq->core_cookie == cookie &&
+	    !rq->core_yield)
+		return next;
+
+again:
+	WRITE_ONCE(rq->core_state, CORE_PENDING);
+	smp_wmb();
+	WRITE_ONCE(rq->core_cookie, cookie);
+	smp_mb();
+
+	if (!sched_core_conflict(rq, cookie) &&
+	    !sched_core_should_yield(rq, cookie)) {
+		WRITE_ONCE(rq->core_state, CORE_RUNNING);
+		sched_core_forceidle_end(rq);
+		smp_mb();
+		sched_core_kick_forceidle(rq);
+		sched_core_kick_conflicting(rq, cookie);
+		return next;
+	}
+
+	WRITE_ONCE(rq->core_state, CORE_IDLE);
+	WRITE_ONCE(rq->core_wait_cookie, cookie);
+	if (!rq->core_forceidle) {
+		rq->core_forceidle_start = rq_clock(rq);
+		schedstat_inc(rq->core_forceidle_count);
+		WRITE_ONCE(rq->core_forceidle, true);
+	}
+	smp_mb();
+
+	/*
+	 * The sibling may have moved on before it could see us forced idle,
+	 * in which case nobody would kick us: check again.
+	 */
+	if (!rq->core_yield && !sched_core_conflict(rq, cookie))
+		goto again;
+
+	if (rq->core_yield || prev_state == CORE_RUNNING) {
+		rq->core_yield = false;
+		sched_core_kick_forceidle(rq);
+	}
+
+	/* Puts @next back, it stays queued for when the core frees up. */
+	return idle_sched_class.pick_next_task(rq, next, rf);
+}
+
+/* Forget core state after core scheduling got disabled. */
+static void sched_core_reset(struct rq *rq)
+{
+	sched_core_forceidle_end(rq);
+	rq->core_yield = false;
+	WRITE_ONCE(rq->core_exempt, false);
+	WRITE_ONCE(rq->core_kick, false);
+	WRITE_ONCE(rq->core_state, CORE_IDLE);
+}
+
+static void sched_core_tick(struct rq *rq)
+{
+	int cpu = cpu_of(rq), i;
+	u64 now = rq_clock(rq);
+
+	if (!sched_core_enabled() || rq->core_state != CORE_RUNNING ||
+	    rq->core_exempt)
+		return;
+
+	for_each_cpu(i, cpu_smt_mask(cpu)) {
+		struct rq *srq = cpu_rq(i);
+
+		if (i == cpu || !READ_ONCE(srq->core_forceidle))
+			continue;
+		if (READ_ONCE(srq->core_wait_cookie) == rq->core_cookie)
+			continue;
+		if ((s64)(now - READ_ONCE(srq->core_forceidle_start)) <
+		    (s64)sysctl_sched_latency)
+			continue;
+
+		rq->core_yield = true;
+		resched_curr(rq);
+		break;
+	}
+}
+
+static unsigned long sched_core_tg_cookie(struct task_group *tg)
+{
+	for (; tg; tg = tg->parent) {
+		if (tg->core_tagged)
+			return (unsigned long)tg;
+	}
+
+	return 0;
+}
+
+/* Called with sched_core_mutex held, for every group that gets tagged. */
+static void sched_core_get(void)
+{
+	lockdep_assert_held(&sched_core_mutex);
+
+	if (!sched_core_count++)
+		static_branch_enable(&__sched_core_enabled);
+}
+
+/* Called with sched_core_mutex held, for every group that loses its tag. */
+static void sched_core_put(void)
+{
+	int cpu;
+
+	lockdep_assert_held(&sched_core_mutex);
+
+	if (--sched_core_count)
+		return;
+
+	static_branch_disable(&__sched_core_enabled);
+	/* Release forced idle CPUs, they would not be kicked anymore: */
+	for_each_online_cpu(cpu)
+		resched_cpu(cpu);
+}
+
+#else /* !CONFIG_SCHED_CORE */
+
+static inline void sched_core_tick(struct rq *rq) { }
+
+#endif /* CONFIG_SCHED_CORE */
+
 /*
  * This function gets called by the timer code, with HZ frequency.
  * We call it with interrupts disabled.
@@ -3102,6 +3741,7 @@ void scheduler_tick(void)
 
 	update_rq_clock(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
+	sched_core_tick(rq);
 	cpu_load_update_active(rq);
 	calc_global_load_tick(rq);
 
@@ -3426,6 +4066,12 @@ static void __sched notrace __schedule(bool preempt)
 	}
 
 	next = pick_next_task(rq, prev, &rf);
+#ifdef CONFIG_SCHED_CORE
+	if (sched_core_enabled())
+		next = sched_core_pick(rq, next, &rf);
+	else if (unlikely(rq->core_state != CORE_IDLE || rq->core_forceidle))
+		sched_core_reset(rq);
+#endif
 	clear_tsk_need_resched(prev);
 	clear_preempt_need_resched();
 
@@ -4077,6 +4723,11 @@ static void __setscheduler_params(struct task_struct *p,
 	p->rt_priority = attr->sched_priority;
 	p->normal_prio = normal_prio(p);
 	set_load_weight(p);
+
+	if (attr->sched_flags & SCHED_FLAG_LATENCY_NICE)
+		p->latency_nice = attr->sched_latency_nice;
+
+	__setscheduler_uclamp(p, attr);
 }
 
 /* Actually do priority change: must hold pi & rq lock. */
@@ -4211,9 +4862,23 @@ recheck:
 			return -EINVAL;
 	}
 
-	if (attr->sched_flags & ~(SCHED_FLAG_RESET_ON_FORK))
+	if (attr->sched_flags &
+		~(SCHED_FLAG_RESET_ON_FORK | SCHED_FLAG_LATENCY_NICE |
+		  SCHED_FLAG_UTIL_CLAMP))
 		return -EINVAL;
 
+	if (attr->sched_flags & SCHED_FLAG_UTIL_CLAMP) {
+		retval = uclamp_validate(p, attr);
+		if (retval)
+			return retval;
+	}
+
+	if (attr->sched_flags & SCHED_FLAG_LATENCY_NICE) {
+		if (attr->sched_latency_nice < MIN_LATENCY_NICE ||
+		    attr->sched_latency_nice > MAX_LATENCY_NICE)
+			return -EINVAL;
+	}
+
 	/*
 	 * Valid priorities for SCHED_FIFO and SCHED_RR are
 	 * 1..MAX_USER_RT_PRIO-1, valid priority for SCHED_NORMAL,
@@ -4275,6 +4940,11 @@ recheck:
 		/* Normal users shall not reset the sched_reset_on_fork flag: */
 		if (p->sched_reset_on_fork && !reset_on_fork)
 			return -EPERM;
+
+		/* Asking for lower wakeup latency is like raising priority: */
+		if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+		    attr->sched_latency_nice < p->latency_nice)
+			return -EPERM;
 	}
 
 	if (user) {
@@ -4312,6 +4982,11 @@ recheck:
 			goto change;
 		if (dl_policy(policy) && dl_param_changed(p, attr))
 			goto change;
+		if ((attr->sched_flags & SCHED_FLAG_LATENCY_NICE) &&
+		    attr->sched_latency_nice != p->latency_nice)
+			goto change;
+		if (uclamp_changed(p, attr))
+			goto change;
 
 		p->sched_reset_on_fork = reset_on_fork;
 		task_rq_unlock(rq, p, &rf);
@@ -4776,6 +5451,22 @@ SYSCALL_DEFINE4(sched_getattr, pid_t, pid, struct sched_attr __user *, uattr,
 	attr.sched_policy = p->policy;
 	if (p->sched_reset_on_fork)
 		attr.sched_flags |= SCHED_FLAG_RESET_ON_FORK;
+	/*
+	 * Only callers that know about the field get to see it, and only
+	 * when it says something; a default value reads back as zero.
+	 */
+	if (size >= SCHED_ATTR_SIZE_VER2 &&
+	    p->latency_nice != DEFAULT_LATENCY_NICE) {
+		attr.sched_flags |= SCHED_FLAG_LATENCY_NICE;
+		attr.sched_latency_nice = p->latency_nice;
+	}
+#ifdef CONFIG_UCLAMP_TASK
+	/* A VER0 caller would otherwise get -EFBIG for the default max */
+	if (size >= SCHED_ATTR_SIZE_VER1) {
+		attr.sched_util_min = p->uclamp_req[UCLAMP_MIN];
+		attr.sched_util_max = p->uclamp_req[UCLAMP_MAX];
+	}
+#endif
 	if (task_has_dl_policy(p))
 		__getparam_dl(p, &attr);
 	else if (task_has_rt_policy(p))
@@ -6025,6 +6716,9 @@ static struct kmem_cache *task_group_cache __read_mostly;
 
 DECLARE_PER_CPU(cpumask_var_t, load_balance_mask);
 DECLARE_PER_CPU(cpumask_var_t, select_idle_mask);
+#ifdef CONFIG_SMP
+DECLARE_PER_CPU(cpumask_var_t, ttwu_ipi_mask);
+#endif
 
 #define WAIT_TABLE_BITS 8
 #define WAIT_TABLE_SIZE (1 << WAIT_TABLE_BITS)
@@ -6081,6 +6775,10 @@ void __init sched_init(void)
 			cpumask_size(), GFP_KERNEL, cpu_to_node(i));
 		per_cpu(select_idle_mask, i) = (cpumask_var_t)kzalloc_node(
 			cpumask_size(), GFP_KERNEL, cpu_to_node(i));
+#ifdef CONFIG_SMP
+		per_cpu(ttwu_ipi_mask, i) = (cpumask_var_t)kzalloc_node(
+			cpumask_size(), GFP_KERNEL, cpu_to_node(i));
+#endif
 	}
 #endif /* CONFIG_CPUMASK_OFFSTACK */
 
@@ -6210,6 +6908,8 @@ void __init sched_init(void)
 
 	init_schedstats();
 
+	init_uclamp();
+
 	scheduler_running = 1;
 }
 
@@ -6394,6 +7094,16 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!tg)
 		return ERR_PTR(-ENOMEM);
 
+#ifdef CONFIG_UCLAMP_TASK
+	/* Unclamped on its own, the parent's range applies once online */
+	tg->uclamp_req[UCLAMP_MIN] = 0;
+	tg->uclamp_req[UCLAMP_MAX] = SCHED_CAPACITY_SCALE;
+	memcpy(tg->uclamp_eff, parent->uclamp_eff, sizeof(tg->uclamp_eff));
+#endif
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	tg->latency_nice_eff = parent->latency_nice_eff;
+#endif
+
 	if (!alloc_fair_sched_group(tg, parent))
 		goto err;
 
@@ -6465,6 +7175,10 @@ static void sched_change_group(struct task_struct *tsk, int type)
 	tg = autogroup_task_group(tsk, tg);
 	tsk->sched_task_group = tg;
 
+#ifdef CONFIG_SCHED_CORE
+	tsk->core_cookie = sched_core_tg_cookie(tg);
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	if (tsk->sched_class->task_change_group)
 		tsk->sched_class->task_change_group(tsk, type);
@@ -6910,6 +7624,27 @@ cpu_cgroup_css_alloc(struct cgroup_subsys_state *parent_css)
 	return &tg->css;
 }
 
+#ifdef CONFIG_FAIR_GROUP_SCHED
+static DEFINE_MUTEX(latency_nice_mutex);
+
+/*
+ * A group's offset stacks on top of its parent's effective one.  Called
+ * with latency_nice_mutex held, parents before children.
+ */
+static void tg_update_latency_nice_eff(struct task_group *tg)
+{
+	int eff = tg->latency_nice;
+
+	lockdep_assert_held(&latency_nice_mutex);
+
+	if (tg->parent)
+		eff += tg->parent->latency_nice_eff;
+	eff = clamp(eff, MIN_LATENCY_NICE, MAX_LATENCY_NICE);
+
+	WRITE_ONCE(tg->latency_nice_eff, eff);
+}
+#endif
+
 /* Expose task group only after completing cgroup initialization */
 static int cpu_cgroup_css_online(struct cgroup_subsys_state *css)
 {
@@ -6918,6 +7653,19 @@ static int cpu_cgroup_css_online(struct cgroup_subsys_state *css)
 
 	if (parent)
 		sched_online_group(tg, parent);
+
+#ifdef CONFIG_UCLAMP_TASK
+	/* The parent's clamps may have changed since the group was created */
+	mutex_lock(&uclamp_mutex);
+	uclamp_update_tg_eff(tg);
+	mutex_unlock(&uclamp_mutex);
+#endif
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	/* The parent's latency nice offset may have changed as well */
+	mutex_lock(&latency_nice_mutex);
+	tg_update_latency_nice_eff(tg);
+	mutex_unlock(&latency_nice_mutex);
+#endif
 	return 0;
 }
 
@@ -6932,6 +7680,16 @@ static void cpu_cgroup_css_free(struct cgroup_subsys_state *css)
 {
 	struct task_group *tg = css_tg(css);
 
+#ifdef CONFIG_SCHED_CORE
+	/* A removed tagged group must not keep core scheduling enabled */
+	mutex_lock(&sched_core_mutex);
+	if (tg->core_tagged) {
+		tg->core_tagged = 0;
+		sched_core_put();
+	}
+	mutex_unlock(&sched_core_mutex);
+#endif
+
 	/*
 	 * Relies on the RCU grace period between css_released() and this.
 	 */
@@ -7014,6 +7772,33 @@ static u64 cpu_shares_read_u64(struct cgroup_subsys_state *css,
 	return (u64) scale_load_down(tg->shares);
 }
 
+static int cpu_latency_nice_write_s64(struct cgroup_subsys_state *css,
+				      struct cftype *cft, s64 latency_nice)
+{
+	struct cgroup_subsys_state *pos;
+
+	if (latency_nice < MIN_LATENCY_NICE || latency_nice > MAX_LATENCY_NICE)
+		return -ERANGE;
+
+	mutex_lock(&latency_nice_mutex);
+	css_tg(css)->latency_nice = latency_nice;
+
+	/* Push the new effective offset down to all descendants */
+	rcu_read_lock();
+	css_for_each_descendant_pre(pos, css)
+		tg_update_latency_nice_eff(css_tg(pos));
+	rcu_read_unlock();
+	mutex_unlock(&latency_nice_mutex);
+
+	return 0;
+}
+
+static s64 cpu_latency_nice_read_s64(struct cgroup_subsys_state *css,
+				     struct cftype *cft)
+{
+	return css_tg(css)->latency_nice;
+}
+
 #ifdef CONFIG_CFS_BANDWIDTH
 static DEFINE_MUTEX(cfs_constraints_mutex);
 
@@ -7286,6 +8071,130 @@ static u64 cpu_rt_period_read_uint(struct cgroup_subsys_state *css,
 }
 #endif /* CONFIG_RT_GROUP_SCHED */
 
+#ifdef CONFIG_UCLAMP_TASK
+static int cpu_uclamp_write(struct cgroup_subsys_state *css,
+			    enum uclamp_id clamp_id, u64 value)
+{
+	struct task_group *tg = css_tg(css);
+	struct cgroup_subsys_state *pos;
+	struct css_task_iter it;
+	struct task_struct *p;
+	int ret = 0;
+
+	if (value > SCHED_CAPACITY_SCALE)
+		return -ERANGE;
+
+	mutex_lock(&uclamp_mutex);
+	if ((clamp_id == UCLAMP_MIN && value > tg->uclamp_req[UCLAMP_MAX]) ||
+	    (clamp_id == UCLAMP_MAX && value < tg->uclamp_req[UCLAMP_MIN])) {
+		ret = -EINVAL;
+		goto unlock;
+	}
+
+	tg->uclamp_req[clamp_id] = value;
+
+	/* Push the new effective range down to all descendants */
+	rcu_read_lock();
+	css_for_each_descendant_pre(pos, css) {
+		uclamp_update_tg_eff(css_tg(pos));
+
+		css_task_iter_start(pos, &it);
+		while ((p = css_task_iter_next(&it)))
+			uclamp_update_active(p);
+		css_task_iter_end(&it);
+	}
+	rcu_read_unlock();
+unlock:
+	mutex_unlock(&uclamp_mutex);
+
+	return ret;
+}
+
+static int cpu_uclamp_min_write_u64(struct cgroup_subsys_state *css,
+				    struct cftype *cft, u64 value)
+{
+	return cpu_uclamp_write(css, UCLAMP_MIN, value);
+}
+
+static int cpu_uclamp_max_write_u64(struct cgroup_subsys_state *css,
+				    struct cftype *cft, u64 value)
+{
+	return cpu_uclamp_write(css, UCLAMP_MAX, value);
+}
+
+static u64 cpu_uclamp_min_read_u64(struct cgroup_subsys_state *css,
+				   struct cftype *cft)
+{
+	return css_tg(css)->uclamp_req[UCLAMP_MIN];
+}
+
+static u64 cpu_uclamp_max_read_u64(struct cgroup_subsys_state *css,
+				   struct cftype *cft)
+{
+	return css_tg(css)->uclamp_req[UCLAMP_MAX];
+}
+#endif /* CONFIG_UCLAMP_TASK */
+
+#ifdef CONFIG_SCHED_CORE
+static void sched_core_update_cookie(struct task_struct *p)
+{
+	struct rq_flags rf;
+	struct rq *rq;
+
+	rq = task_rq_lock(p, &rf);
+	p->core_cookie = sched_core_tg_cookie(task_group(p));
+	if (task_running(rq, p))
+		resched_curr(rq);
+	task_rq_unlock(rq, p, &rf);
+}
+
+static u64 cpu_core_tag_read_u64(struct cgroup_subsys_state *css,
+				 struct cftype *cft)
+{
+	return css_tg(css)->core_tagged;
+}
+
+static int cpu_core_tag_write_u64(struct cgroup_subsys_state *css,
+				  struct cftype *cft, u64 val)
+{
+	struct task_group *tg = css_tg(css);
+	struct cgroup_subsys_state *pos;
+	struct css_task_iter it;
+	struct task_struct *p;
+
+	if (val > 1)
+		return -ERANGE;
+
+	if (!static_branch_likely(&sched_smt_present))
+		return -EINVAL;
+
+	mutex_lock(&sched_core_mutex);
+	if (tg->core_tagged == val)
+		goto unlock;
+
+	if (val)
+		sched_core_get();
+
+	tg->core_tagged = val;
+
+	rcu_read_lock();
+	css_for_each_descendant_pre(pos, css) {
+		css_task_iter_start(pos, &it);
+		while ((p = css_task_iter_next(&it)))
+			sched_core_update_cookie(p);
+		css_task_iter_end(&it);
+	}
+	rcu_read_unlock();
+
+	if (!val)
+		sched_core_put();
+unlock:
+	mutex_unlock(&sched_core_mutex);
+
+	return 0;
+}
+#endif /* CONFIG_SCHED_CORE */
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -7293,6 +8202,34 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_shares_read_u64,
 		.write_u64 = cpu_shares_write_u64,
 	},
+	{
+		.name = "latency_nice",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_s64 = cpu_latency_nice_read_s64,
+		.write_s64 = cpu_latency_nice_write_s64,
+	},
+#endif
+#ifdef CONFIG_UCLAMP_TASK
+	{
+		.name = "uclamp.min",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_uclamp_min_read_u64,
+		.write_u64 = cpu_uclamp_min_write_u64,
+	},
+	{
+		.name = "uclamp.max",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_uclamp_max_read_u64,
+		.write_u64 = cpu_uclamp_max_write_u64,
+	},
+#endif
+#ifdef CONFIG_SCHED_CORE
+	{
+		.name = "core_tag",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_core_tag_read_u64,
+		.write_u64 = cpu_core_tag_write_u64,
+	},
 #endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
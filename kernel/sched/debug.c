@@ -831,6 +831,11 @@ void print_numa_stats(struct seq_file *m, int node, unsigned long tsf,
 	SEQ_printf(m, "task_private=%lu task_shared=%lu ", tsf, tpf);
 	SEQ_printf(m, "group_private=%lu group_shared=%lu\n", gsf, gpf);
 }
+
+void print_numa_sampled_stats(struct seq_file *m, int node, unsigned long pages)
+{
+	SEQ_printf(m, "numa_sampled_migrated node=%d pages=%lu\n", node, pages);
+}
 #endif
 
 
@@ -954,6 +959,7 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 #endif
 	P(policy);
 	P(prio);
+	P(latency_nice);
 	if (p->policy == SCHED_DEADLINE) {
 		P(dl.runtime);
 		P(dl.deadline);
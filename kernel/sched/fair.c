@@ -298,80 +298,108 @@ static inline struct cfs_rq *group_cfs_rq(struct sched_entity *grp)
 	return grp->my_q;
 }
 
-static inline void list_add_leaf_cfs_rq(struct cfs_rq *cfs_rq)
+static inline bool list_add_leaf_cfs_rq(struct cfs_rq *cfs_rq)
 {
-	if (!cfs_rq->on_list) {
-		struct rq *rq = rq_of(cfs_rq);
-		int cpu = cpu_of(rq);
+	struct rq *rq = rq_of(cfs_rq);
+	int cpu = cpu_of(rq);
+
+	if (cfs_rq->on_list)
+		return rq->tmp_alone_branch == &rq->leaf_cfs_rq_list;
+
+	cfs_rq->on_list = 1;
+
+	/*
+	 * Ensure we either appear before our parent (if already
+	 * enqueued) or force our parent to appear after us when it is
+	 * enqueued. The fact that we always enqueue bottom-up
+	 * reduces this to two cases and a special case for the root
+	 * cfs_rq. Furthermore, it also means that we will always reset
+	 * tmp_alone_branch either when the branch is connected
+	 * to a tree or when we reach the top of the tree
+	 */
+	if (cfs_rq->tg->parent &&
+	    cfs_rq->tg->parent->cfs_rq[cpu]->on_list) {
 		/*
-		 * Ensure we either appear before our parent (if already
-		 * enqueued) or force our parent to appear after us when it is
-		 * enqueued. The fact that we always enqueue bottom-up
-		 * reduces this to two cases and a special case for the root
-		 * cfs_rq. Furthermore, it also means that we will always reset
-		 * tmp_alone_branch either when the branch is connected
-		 * to a tree or when we reach the beg of the tree
+		 * If parent is already on the list, we add the child
+		 * just before. Thanks to circular linked property of
+		 * the list, this means to put the child at the tail
+		 * of the list that starts by parent.
 		 */
-		if (cfs_rq->tg->parent &&
-		    cfs_rq->tg->parent->cfs_rq[cpu]->on_list) {
-			/*
-			 * If parent is already on the list, we add the child
-			 * just before. Thanks to circular linked property of
-			 * the list, this means to put the child at the tail
-			 * of the list that starts by parent.
-			 */
-			list_add_tail_rcu(&cfs_rq->leaf_cfs_rq_list,
-				&(cfs_rq->tg->parent->cfs_rq[cpu]->leaf_cfs_rq_list));
-			/*
-			 * The branch is now connected to its tree so we can
-			 * reset tmp_alone_branch to the beginning of the
-			 * list.
-			 */
-			rq->tmp_alone_branch = &rq->leaf_cfs_rq_list;
-		} else if (!cfs_rq->tg->parent) {
-			/*
-			 * cfs rq without parent should be put
-			 * at the tail of the list.
-			 */
-			list_add_tail_rcu(&cfs_rq->leaf_cfs_rq_list,
-				&rq->leaf_cfs_rq_list);
-			/*
-			 * We have reach the beg of a tree so we can reset
-			 * tmp_alone_branch to the beginning of the list.
-			 */
-			rq->tmp_alone_branch = &rq->leaf_cfs_rq_list;
-		} else {
-			/*
-			 * The parent has not already been added so we want to
-			 * make sure that it will be put after us.
-			 * tmp_alone_branch points to the beg of the branch
-			 * where we will add parent.
-			 */
-			list_add_rcu(&cfs_rq->leaf_cfs_rq_list,
-				rq->tmp_alone_branch);
-			/*
-			 * update tmp_alone_branch to points to the new beg
-			 * of the branch
-			 */
-			rq->tmp_alone_branch = &cfs_rq->leaf_cfs_rq_list;
-		}
+		list_add_tail_rcu(&cfs_rq->leaf_cfs_rq_list,
+			&(cfs_rq->tg->parent->cfs_rq[cpu]->leaf_cfs_rq_list));
+		/*
+		 * The branch is now connected to its tree so we can
+		 * reset tmp_alone_branch to the beginning of the
+		 * list.
+		 */
+		rq->tmp_alone_branch = &rq->leaf_cfs_rq_list;
+		return true;
+	}
 
-		cfs_rq->on_list = 1;
+	if (!cfs_rq->tg->parent) {
+		/*
+		 * cfs rq without parent should be put
+		 * at the tail of the list.
+		 */
+		list_add_tail_rcu(&cfs_rq->leaf_cfs_rq_list,
+			&rq->leaf_cfs_rq_list);
+		/*
+		 * We have reach the top of a tree so we can reset
+		 * tmp_alone_branch to the beginning of the list.
+		 */
+		rq->tmp_alone_branch = &rq->leaf_cfs_rq_list;
+		return true;
 	}
+
+	/*
+	 * The parent has not already been added so we want to
+	 * make sure that it will be put after us.
+	 * tmp_alone_branch points to the begin of the branch
+	 * where we will add parent.
+	 */
+	list_add_rcu(&cfs_rq->leaf_cfs_rq_list, rq->tmp_alone_branch);
+	/*
+	 * update tmp_alone_branch to points to the new begin
+	 * of the branch
+	 */
+	rq->tmp_alone_branch = &cfs_rq->leaf_cfs_rq_list;
+	return false;
 }
 
 static inline void list_del_leaf_cfs_rq(struct cfs_rq *cfs_rq)
 {
 	if (cfs_rq->on_list) {
+		struct rq *rq = rq_of(cfs_rq);
+
+		/*
+		 * With cfs_rq being unthrottled/throttled during an enqueue,
+		 * it can happen the tmp_alone_branch points to the leaf that
+		 * we finally want to del. In this case, tmp_alone_branch moves
+		 * to the prev element but it will point to rq->leaf_cfs_rq_list
+		 * at the end of the enqueue.
+		 */
+		if (rq->tmp_alone_branch == &cfs_rq->leaf_cfs_rq_list)
+			rq->tmp_alone_branch = cfs_rq->leaf_cfs_rq_list.prev;
+
 		list_del_rcu(&cfs_rq->leaf_cfs_rq_list);
 		cfs_rq->on_list = 0;
 	}
 }
 
+static inline void assert_list_leaf_cfs_rq(struct rq *rq)
+{
+	SCHED_WARN_ON(rq->tmp_alone_branch != &rq->leaf_cfs_rq_list);
+}
+
 /* Iterate thr' all leaf cfs_rq's on a runqueue */
 #define for_each_leaf_cfs_rq(rq, cfs_rq) \
 	list_for_each_entry_rcu(cfs_rq, &rq->leaf_cfs_rq_list, leaf_cfs_rq_list)
 
+/* Same, allowing the current cfs_rq to be removed from the list */
+#define for_each_leaf_cfs_rq_safe(rq, cfs_rq, pos)			\
+	list_for_each_entry_safe(cfs_rq, pos, &rq->leaf_cfs_rq_list,	\
+				 leaf_cfs_rq_list)
+
 /* Do the two (enqueued) entities belong to the same group ? */
 static inline struct cfs_rq *
 is_same_group(struct sched_entity *se, struct sched_entity *pse)
@@ -455,17 +483,25 @@ static inline struct cfs_rq *group_cfs_rq(struct sched_entity *grp)
 	return NULL;
 }
 
-static inline void list_add_leaf_cfs_rq(struct cfs_rq *cfs_rq)
+static inline bool list_add_leaf_cfs_rq(struct cfs_rq *cfs_rq)
 {
+	return true;
 }
 
 static inline void list_del_leaf_cfs_rq(struct cfs_rq *cfs_rq)
 {
 }
 
+static inline void assert_list_leaf_cfs_rq(struct rq *rq)
+{
+}
+
 #define for_each_leaf_cfs_rq(rq, cfs_rq) \
 		for (cfs_rq = &rq->cfs; cfs_rq; cfs_rq = NULL)
 
+#define for_each_leaf_cfs_rq_safe(rq, cfs_rq, pos) \
+		for (cfs_rq = &rq->cfs, pos = NULL; cfs_rq; cfs_rq = pos)
+
 static inline struct sched_entity *parent_entity(struct sched_entity *se)
 {
 	return NULL;
@@ -1070,6 +1106,20 @@ unsigned int sysctl_numa_balancing_scan_size = 256;
 /* Scan @scan_size MB every @scan_period after an initial @scan_delay in ms */
 unsigned int sysctl_numa_balancing_scan_delay = 1000;
 
+/*
+ * Find hot remote pages by sampling pte accessed bits rather than by
+ * unmapping the scan window and taking NUMA hinting faults.  This
+ * consumes the PG_idle/PG_young page flags, so it must not be combined
+ * with /sys/kernel/mm/page_idle or the kidled working-set scanner.
+ */
+unsigned int sysctl_numa_balancing_scan_sampling;
+
+static inline bool numa_scan_sampling(void)
+{
+	return IS_ENABLED(CONFIG_IDLE_PAGE_TRACKING) &&
+		READ_ONCE(sysctl_numa_balancing_scan_sampling);
+}
+
 static unsigned int task_nr_scan_windows(struct task_struct *p)
 {
 	unsigned long rss = 0;
@@ -2314,6 +2364,9 @@ void task_numa_free(struct task_struct *p)
 
 	p->numa_faults = NULL;
 	kfree(numa_faults);
+
+	kfree(p->numa_sampled_migrated);
+	p->numa_sampled_migrated = NULL;
 }
 
 /*
@@ -2405,6 +2458,34 @@ static void reset_ptenuma_scan(struct task_struct *p)
 	p->mm->numa_scan_offset = 0;
 }
 
+/*
+ * Sampling scans take no hinting faults, so update_task_scan_period()
+ * never runs for them. Adapt the scan rate to the outcome of the last
+ * window instead: scan faster while hot remote pages keep turning up,
+ * back off while the working set is already local.
+ */
+static void task_numa_sample_update(struct task_struct *p, int nid,
+				    unsigned long migrated)
+{
+	if (!migrated) {
+		p->numa_scan_period = min(p->numa_scan_period_max,
+					  p->numa_scan_period << 1);
+		return;
+	}
+
+	p->numa_scan_period = max(task_scan_min(p),
+				  p->numa_scan_period >> 1);
+	p->numa_pages_migrated += migrated;
+
+	if (!p->numa_sampled_migrated) {
+		p->numa_sampled_migrated = kcalloc(nr_node_ids,
+				sizeof(unsigned long), GFP_KERNEL|__GFP_NOWARN);
+		if (!p->numa_sampled_migrated)
+			return;
+	}
+	p->numa_sampled_migrated[nid] += migrated;
+}
+
 /*
  * The expensive part of numa migration is done from task_work context.
  * Triggered from task_tick_numa().
@@ -2418,6 +2499,9 @@ void task_numa_work(struct callback_head *work)
 	struct vm_area_struct *vma;
 	unsigned long start, end;
 	unsigned long nr_pte_updates = 0;
+	unsigned long nr_migrated = 0;
+	bool sampling = numa_scan_sampling();
+	int target_nid;
 	long pages, virtpages;
 
 	SCHED_WARN_ON(p != container_of(work, struct task_struct, numa_work));
@@ -2468,6 +2552,9 @@ void task_numa_work(struct callback_head *work)
 	if (!pages)
 		return;
 
+	target_nid = p->numa_preferred_nid;
+	if (target_nid == -1)
+		target_nid = numa_node_id();
 
 	down_read(&mm->mmap_sem);
 	vma = find_vma(mm, start);
@@ -2503,7 +2590,12 @@ void task_numa_work(struct callback_head *work)
 			start = max(start, vma->vm_start);
 			end = ALIGN(start + (pages << PAGE_SHIFT), HPAGE_SIZE);
 			end = min(end, vma->vm_end);
-			nr_pte_updates = change_prot_numa(vma, start, end);
+			if (sampling)
+				nr_pte_updates = numa_migrate_hot_pages(vma,
+						start, end, target_nid,
+						&nr_migrated);
+			else
+				nr_pte_updates = change_prot_numa(vma, start, end);
 
 			/*
 			 * Try to scan sysctl_numa_balancing_size worth of
@@ -2538,6 +2630,9 @@ out:
 		reset_ptenuma_scan(p);
 	up_read(&mm->mmap_sem);
 
+	if (sampling)
+		task_numa_sample_update(p, target_nid, nr_migrated);
+
 	/*
 	 * Make sure tasks use at least 32x as much time to run other code
 	 * than they used here, to limit NUMA PTE scanning overhead to 3% max.
@@ -4278,6 +4373,16 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 	if (!se)
 		add_nr_running(rq, task_delta);
 
+	/* Same as in enqueue_task_fair(): connect the rest of the branch */
+	for_each_sched_entity(se) {
+		cfs_rq = cfs_rq_of(se);
+
+		if (list_add_leaf_cfs_rq(cfs_rq))
+			break;
+	}
+
+	assert_list_leaf_cfs_rq(rq);
+
 	/* determine whether we need to wake up potentially idle cpu */
 	if (rq->curr == rq->idle && rq->cfs.nr_running)
 		resched_curr(rq);
@@ -4827,6 +4932,24 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 	if (!se)
 		add_nr_running(rq, 1);
 
+	if (cfs_bandwidth_used()) {
+		/*
+		 * When bandwidth control is enabled, the cfs_rq_throttled()
+		 * breaks above can leave the leaf list half built, with
+		 * tmp_alone_branch pointing into a branch that is not
+		 * connected yet.  Finish connecting it; pruning decayed
+		 * cfs_rqs relies on tmp_alone_branch being reset here.
+		 */
+		for_each_sched_entity(se) {
+			cfs_rq = cfs_rq_of(se);
+
+			if (list_add_leaf_cfs_rq(cfs_rq))
+				break;
+		}
+	}
+
+	assert_list_leaf_cfs_rq(rq);
+
 	hrtick_update(rq);
 }
 
@@ -5677,6 +5800,83 @@ again:
 		(cpu) = cpumask_next_wrap((cpu), (mask), (start), &(wrap)),	\
 		(cpu) < nr_cpumask_bits; )
 
+/*
+ * Keep sd_llc_shared's idle masks up to date on idle entry and exit. A CPU
+ * is in the idle core mask when all its SMT siblings are in the idle CPU
+ * mask; any sibling leaving idle takes the whole core out again.
+ */
+void update_idle_cpumask(struct rq *rq, bool idle)
+{
+	struct sched_domain_shared *sds;
+	int cpu = cpu_of(rq);
+	struct cpumask *cpus;
+
+	rcu_read_lock();
+	sds = rcu_dereference(per_cpu(sd_llc_shared, cpu));
+	if (!sds)
+		goto unlock;
+
+	cpus = sds_idle_cpus(sds);
+	if (idle) {
+		if (!cpumask_test_cpu(cpu, cpus))
+			cpumask_set_cpu(cpu, cpus);
+	} else {
+		if (cpumask_test_cpu(cpu, cpus))
+			cpumask_clear_cpu(cpu, cpus);
+	}
+
+#ifdef CONFIG_SCHED_SMT
+	if (static_branch_likely(&sched_smt_present)) {
+		const struct cpumask *smt = cpu_smt_mask(cpu);
+		struct cpumask *cores = sds_idle_cores(sds);
+		int sibling;
+
+		if (idle) {
+			/*
+			 * Pairs with the same barrier on the sibling, so that
+			 * the last of two siblings going idle together sees
+			 * the other's bit and marks the core idle.
+			 */
+			smp_mb__after_atomic();
+			if (cpumask_subset(smt, cpus) &&
+			    !cpumask_test_cpu(cpu, cores)) {
+				for_each_cpu(sibling, smt)
+					cpumask_set_cpu(sibling, cores);
+			}
+		} else if (cpumask_test_cpu(cpu, cores)) {
+			for_each_cpu(sibling, smt)
+				cpumask_clear_cpu(sibling, cores);
+		}
+	}
+#endif
+unlock:
+	rcu_read_unlock();
+}
+
+/*
+ * Pick the first CPU of @mask in the LLC domain @sd, starting from @target,
+ * that @p may run on and that is still idle.
+ */
+static int select_idle_from_mask(struct task_struct *p, struct sched_domain *sd,
+				 int target, const struct cpumask *mask, int nr)
+{
+	struct cpumask *cpus = this_cpu_cpumask_var_ptr(select_idle_mask);
+	int cpu, wrap;
+
+	cpumask_and(cpus, mask, sched_domain_span(sd));
+	cpumask_and(cpus, cpus, &p->cpus_allowed);
+
+	for_each_cpu_wrap(cpu, cpus, target, wrap) {
+		if (!nr--)
+			break;
+		schedstat_inc(this_rq()->sis_scanned);
+		if (idle_cpu(cpu))
+			return cpu;
+	}
+
+	return -1;
+}
+
 #ifdef CONFIG_SCHED_SMT
 
 static inline void set_idle_cores(int cpu, int val)
@@ -5733,7 +5933,8 @@ unlock:
  * there are no idle cores left in the system; tracked through
  * sd_llc->shared->has_idle_cores and enabled through update_idle_core() above.
  */
-static int select_idle_core(struct task_struct *p, struct sched_domain *sd, int target)
+static int select_idle_core(struct task_struct *p, struct sched_domain *sd,
+			    int target, int nr)
 {
 	struct cpumask *cpus = this_cpu_cpumask_var_ptr(select_idle_mask);
 	int core, cpu, wrap;
@@ -5741,6 +5942,15 @@ static int select_idle_core(struct task_struct *p, struct sched_domain *sd, int
 	if (!static_branch_likely(&sched_smt_present))
 		return -1;
 
+	if (sched_feat(SIS_IDLE_MASK)) {
+		struct sched_domain_shared *sds;
+
+		sds = rcu_dereference(per_cpu(sd_llc_shared, target));
+		if (sds)
+			return select_idle_from_mask(p, sd, target,
+						     sds_idle_cores(sds), nr);
+	}
+
 	if (!test_idle_cores(target, false))
 		return -1;
 
@@ -5749,8 +5959,12 @@ static int select_idle_core(struct task_struct *p, struct sched_domain *sd, int
 	for_each_cpu_wrap(core, cpus, target, wrap) {
 		bool idle = true;
 
+		if (!nr--)
+			return -1;
+
 		for_each_cpu(cpu, cpu_smt_mask(core)) {
 			cpumask_clear_cpu(cpu, cpus);
+			schedstat_inc(this_rq()->sis_scanned);
 			if (!idle_cpu(cpu))
 				idle = false;
 		}
@@ -5789,7 +6003,8 @@ static int select_idle_smt(struct task_struct *p, struct sched_domain *sd, int t
 
 #else /* CONFIG_SCHED_SMT */
 
-static inline int select_idle_core(struct task_struct *p, struct sched_domain *sd, int target)
+static inline int select_idle_core(struct task_struct *p, struct sched_domain *sd,
+				   int target, int nr)
 {
 	return -1;
 }
@@ -5806,7 +6021,8 @@ static inline int select_idle_smt(struct task_struct *p, struct sched_domain *sd
  * comparing the average scan cost (tracked in sd->avg_scan_cost) against the
  * average idle time for this rq (as found in rq->avg_idle).
  */
-static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int target)
+static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd,
+			   int target, int nr)
 {
 	struct sched_domain *this_sd;
 	u64 avg_cost, avg_idle = this_rq()->avg_idle;
@@ -5814,6 +6030,15 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int t
 	s64 delta;
 	int cpu, wrap;
 
+	if (sched_feat(SIS_IDLE_MASK)) {
+		struct sched_domain_shared *sds;
+
+		sds = rcu_dereference(per_cpu(sd_llc_shared, target));
+		if (sds)
+			return select_idle_from_mask(p, sd, target,
+						     sds_idle_cpus(sds), nr);
+	}
+
 	this_sd = rcu_dereference(*this_cpu_ptr(&sd_llc));
 	if (!this_sd)
 		return -1;
@@ -5824,7 +6049,8 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int t
 	 * Due to large variance we need a large fuzz factor; hackbench in
 	 * particularly is sensitive here.
 	 */
-	if (sched_feat(SIS_AVG_CPU) && (avg_idle / 512) < avg_cost)
+	if (sched_feat(SIS_AVG_CPU) && task_latency_nice(p) >= 0 &&
+	    (avg_idle / 512) < avg_cost)
 		return -1;
 
 	time = local_clock();
@@ -5832,6 +6058,11 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int t
 	for_each_cpu_wrap(cpu, sched_domain_span(sd), target, wrap) {
 		if (!cpumask_test_cpu(cpu, &p->cpus_allowed))
 			continue;
+		if (!nr--) {
+			cpu = -1;
+			break;
+		}
+		schedstat_inc(this_rq()->sis_scanned);
 		if (idle_cpu(cpu))
 			break;
 	}
@@ -5844,13 +6075,31 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int t
 	return cpu;
 }
 
+/*
+ * How many CPUs (or cores) of the LLC domain a wakeup of @p may look at for
+ * an idle one: all of them unless the task has a positive latency nice, in
+ * which case the search gets shallower down to none at MAX_LATENCY_NICE.
+ */
+static int sis_scan_depth(struct task_struct *p, struct sched_domain *sd)
+{
+	int latency_nice = task_latency_nice(p);
+
+	if (latency_nice <= 0)
+		return sd->span_weight;
+
+	return sd->span_weight * (MAX_LATENCY_NICE - latency_nice) /
+		MAX_LATENCY_NICE;
+}
+
 /*
  * Try and locate an idle core/thread in the LLC cache domain.
  */
 static int select_idle_sibling(struct task_struct *p, int prev, int target)
 {
 	struct sched_domain *sd;
-	int i;
+	int i, nr;
+
+	schedstat_inc(this_rq()->sis_search);
 
 	if (idle_cpu(target))
 		return target;
@@ -5865,18 +6114,27 @@ static int select_idle_sibling(struct task_struct *p, int prev, int target)
 	if (!sd)
 		return target;
 
-	i = select_idle_core(p, sd, target);
+	nr = sis_scan_depth(p, sd);
+	if (!nr)
+		goto smt;
+
+	schedstat_inc(this_rq()->sis_domain_search);
+
+	i = select_idle_core(p, sd, target, nr);
 	if ((unsigned)i < nr_cpumask_bits)
 		return i;
 
-	i = select_idle_cpu(p, sd, target);
+	i = select_idle_cpu(p, sd, target, nr);
 	if ((unsigned)i < nr_cpumask_bits)
 		return i;
 
+smt:
 	i = select_idle_smt(p, sd, target);
 	if ((unsigned)i < nr_cpumask_bits)
 		return i;
 
+	schedstat_inc(this_rq()->sis_failed);
+
 	return target;
 }
 
@@ -6134,6 +6392,20 @@ wakeup_gran(struct sched_entity *curr, struct sched_entity *se)
 	return calc_delta_fair(gran, se);
 }
 
+/*
+ * Latency nice moves the wakeup preemption threshold: a waking task that is
+ * more latency sensitive than current preempts it earlier, possibly even
+ * before it has fallen behind in vruntime, and a less sensitive one later.
+ * The full latency nice range is worth about one sched_latency period.
+ * This changes who runs first, not how much CPU each task gets.
+ */
+static s64 wakeup_latency_gran(struct task_struct *curr, struct task_struct *p)
+{
+	int latency_diff = task_latency_nice(p) - task_latency_nice(curr);
+
+	return (s64)latency_diff * (s64)sysctl_sched_latency / LATENCY_NICE_WIDTH;
+}
+
 /*
  * Should 'se' preempt 'curr'.
  *
@@ -6163,6 +6435,25 @@ wakeup_preempt_entity(struct sched_entity *curr, struct sched_entity *se)
 	return 0;
 }
 
+/*
+ * Should 'se' preempt 'curr' at wakeup, with the wakeup granularity offset
+ * by @latency_gran (in real time) as computed by wakeup_latency_gran().
+ */
+static bool
+wakeup_preempt_latency(struct sched_entity *curr, struct sched_entity *se,
+		       s64 latency_gran)
+{
+	s64 gran, vdiff = curr->vruntime - se->vruntime;
+
+	gran = wakeup_gran(curr, se);
+	if (latency_gran >= 0)
+		gran += calc_delta_fair(latency_gran, se);
+	else
+		gran -= calc_delta_fair(-latency_gran, se);
+
+	return vdiff > gran;
+}
+
 static void set_last_buddy(struct sched_entity *se)
 {
 	if (entity_is_task(se) && unlikely(task_of(se)->policy == SCHED_IDLE))
@@ -6243,7 +6534,7 @@ static void check_preempt_wakeup(struct rq *rq, struct task_struct *p, int wake_
 	find_matching_se(&se, &pse);
 	update_curr(cfs_rq_of(se));
 	BUG_ON(!pse);
-	if (wakeup_preempt_entity(se, pse) == 1) {
+	if (wakeup_preempt_latency(se, pse, wakeup_latency_gran(curr, p))) {
 		/*
 		 * Bias pick_next to pick the sched entity that is
 		 * triggering this preemption.
@@ -6970,11 +7261,36 @@ static void attach_tasks(struct lb_env *env)
 }
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
+
+static inline bool cfs_rq_is_decayed(struct cfs_rq *cfs_rq)
+{
+	if (cfs_rq->load.weight)
+		return false;
+
+	if (cfs_rq->avg.load_sum)
+		return false;
+
+	if (cfs_rq->avg.util_sum)
+		return false;
+
+	if (cfs_rq->runnable_load_sum)
+		return false;
+
+	if (cfs_rq->propagate_avg)
+		return false;
+
+	return true;
+}
+
 static void update_blocked_averages(int cpu)
 {
 	struct rq *rq = cpu_rq(cpu);
-	struct cfs_rq *cfs_rq;
+	struct cfs_rq *cfs_rq, *pos;
 	struct rq_flags rf;
+	u64 start = 0;
+
+	if (schedstat_enabled())
+		start = local_clock();
 
 	rq_lock_irqsave(rq, &rf);
 	update_rq_clock(rq);
@@ -6983,9 +7299,11 @@ static void update_blocked_averages(int cpu)
 	 * Iterates the task_group tree in a bottom up fashion, see
 	 * list_add_leaf_cfs_rq() for details.
 	 */
-	for_each_leaf_cfs_rq(rq, cfs_rq) {
+	for_each_leaf_cfs_rq_safe(rq, cfs_rq, pos) {
 		struct sched_entity *se;
 
+		schedstat_inc(rq->blocked_update_scanned);
+
 		/* throttled entities do not contribute to load */
 		if (throttled_hierarchy(cfs_rq))
 			continue;
@@ -6997,8 +7315,21 @@ static void update_blocked_averages(int cpu)
 		se = cfs_rq->tg->se[cpu];
 		if (se && !skip_blocked_update(se))
 			update_load_avg(se, 0);
+
+		/*
+		 * There can be a lot of idle CPU cgroups.  Don't let fully
+		 * decayed cfs_rqs linger on the list; enqueue_entity() puts
+		 * them back once they get a task again.
+		 */
+		if (cfs_rq_is_decayed(cfs_rq)) {
+			list_del_leaf_cfs_rq(cfs_rq);
+			schedstat_inc(rq->blocked_update_pruned);
+		}
 	}
 	rq_unlock_irqrestore(rq, &rf);
+
+	schedstat_inc(rq->blocked_update_count);
+	schedstat_add(rq->blocked_update_time, local_clock() - start);
 }
 
 /*
@@ -7054,10 +7385,19 @@ static inline void update_blocked_averages(int cpu)
 	struct cfs_rq *cfs_rq = &rq->cfs;
 	struct rq_flags rf;
 
+	u64 start = 0;
+
+	if (schedstat_enabled())
+		start = local_clock();
+
 	rq_lock_irqsave(rq, &rf);
 	update_rq_clock(rq);
 	update_cfs_rq_load_avg(cfs_rq_clock_task(cfs_rq), cfs_rq, true);
 	rq_unlock_irqrestore(rq, &rf);
+
+	schedstat_inc(rq->blocked_update_count);
+	schedstat_inc(rq->blocked_update_scanned);
+	schedstat_add(rq->blocked_update_time, local_clock() - start);
 }
 
 static unsigned long task_h_load(struct task_struct *p)
@@ -7389,6 +7729,72 @@ group_type group_classify(struct sched_group *group,
 	return group_other;
 }
 
+/*
+ * Fill in the per-CPU sums of @sgs from the group's cache if another CPU
+ * gathered them with the same @load_idx during this jiffy.
+ */
+static bool sg_lb_cache_read(struct lb_env *env, struct sched_group *group,
+			     int load_idx, struct sg_lb_stats *sgs,
+			     bool *overload)
+{
+	struct sg_lb_cache *c = &group->sgc->lb_cache;
+	bool group_overload;
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&c->seq);
+
+		if (c->stamp != jiffies || c->load_idx != load_idx) {
+			schedstat_inc(env->sd->lb_sgs_miss);
+			return false;
+		}
+
+		group_overload = c->overload;
+		sgs->group_load = c->group_load;
+		sgs->group_util = c->group_util;
+		sgs->sum_weighted_load = c->sum_weighted_load;
+		sgs->sum_nr_running = c->sum_nr_running;
+		sgs->idle_cpus = c->idle_cpus;
+#ifdef CONFIG_NUMA_BALANCING
+		sgs->nr_numa_running = c->nr_numa_running;
+		sgs->nr_preferred_running = c->nr_preferred_running;
+#endif
+	} while (read_seqcount_retry(&c->seq, seq));
+
+	if (group_overload)
+		*overload = true;
+
+	schedstat_inc(env->sd->lb_sgs_hit);
+	return true;
+}
+
+static void sg_lb_cache_write(struct sched_group *group, int load_idx,
+			      struct sg_lb_stats *sgs, bool overload)
+{
+	struct sg_lb_cache *c = &group->sgc->lb_cache;
+
+	/* Someone else is updating it already, no need to wait: */
+	if (!raw_spin_trylock(&c->lock))
+		return;
+
+	write_seqcount_begin(&c->seq);
+	c->stamp = jiffies;
+	c->load_idx = load_idx;
+	c->overload = overload;
+	c->group_load = sgs->group_load;
+	c->group_util = sgs->group_util;
+	c->sum_weighted_load = sgs->sum_weighted_load;
+	c->sum_nr_running = sgs->sum_nr_running;
+	c->idle_cpus = sgs->idle_cpus;
+#ifdef CONFIG_NUMA_BALANCING
+	c->nr_numa_running = sgs->nr_numa_running;
+	c->nr_preferred_running = sgs->nr_preferred_running;
+#endif
+	write_seqcount_end(&c->seq);
+
+	raw_spin_unlock(&c->lock);
+}
+
 /**
  * update_sg_lb_stats - Update sched_group's statistics for load balancing.
  * @env: The load balancing environment.
@@ -7403,11 +7809,23 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 			int local_group, struct sg_lb_stats *sgs,
 			bool *overload)
 {
+	bool group_overload = false;
 	unsigned long load;
 	int i, nr_running;
+	bool cache;
 
 	memset(sgs, 0, sizeof(*sgs));
 
+	/*
+	 * Only the sums of remote groups over all their CPUs can be shared:
+	 * the local group is biased through target_load() and retries after
+	 * failed balancing exclude CPUs.
+	 */
+	cache = sched_feat(LB_STATS_CACHE) && !local_group &&
+		cpumask_subset(sched_group_cpus(group), env->cpus);
+	if (cache && sg_lb_cache_read(env, group, load_idx, sgs, overload))
+		goto capacity;
+
 	for_each_cpu_and(i, sched_group_cpus(group), env->cpus) {
 		struct rq *rq = cpu_rq(i);
 
@@ -7423,7 +7841,7 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 
 		nr_running = rq->nr_running;
 		if (nr_running > 1)
-			*overload = true;
+			group_overload = true;
 
 #ifdef CONFIG_NUMA_BALANCING
 		sgs->nr_numa_running += rq->nr_numa_running;
@@ -7437,6 +7855,13 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 			sgs->idle_cpus++;
 	}
 
+	if (group_overload)
+		*overload = true;
+
+	if (cache)
+		sg_lb_cache_write(group, load_idx, sgs, group_overload);
+
+capacity:
 	/* Adjust by relative CPU capacity of the group */
 	sgs->group_capacity = group->sgc->capacity;
 	sgs->avg_load = (sgs->group_load*SCHED_CAPACITY_SCALE) / sgs->group_capacity;
@@ -7562,6 +7987,10 @@ static inline void update_sd_lb_stats(struct lb_env *env, struct sd_lb_stats *sd
 	struct sg_lb_stats tmp_sgs;
 	int load_idx, prefer_sibling = 0;
 	bool overload = false;
+	u64 start = 0;
+
+	if (schedstat_enabled())
+		start = local_clock();
 
 	if (child && child->flags & SD_PREFER_SIBLING)
 		prefer_sibling = 1;
@@ -7627,6 +8056,7 @@ next_group:
 			env->dst_rq->rd->overload = overload;
 	}
 
+	schedstat_add(env->sd->lb_stats_time, local_clock() - start);
 }
 
 /**
@@ -9548,6 +9978,12 @@ void show_numa_stats(struct task_struct *p, struct seq_file *m)
 		}
 		print_numa_stats(m, node, tsf, tpf, gsf, gpf);
 	}
+
+	if (p->numa_sampled_migrated) {
+		for_each_online_node(node)
+			print_numa_sampled_stats(m, node,
+					p->numa_sampled_migrated[node]);
+	}
 }
 #endif /* CONFIG_NUMA_BALANCING */
 #endif /* CONFIG_SCHED_DEBUG */
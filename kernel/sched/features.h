@@ -51,11 +51,29 @@ SCHED_FEAT(NONTASK_CAPACITY, true)
  */
 SCHED_FEAT(TTWU_QUEUE, true)
 
+/*
+ * Inside a wakeup batch (wake_up_q(), __wake_up()) defer the IPIs for
+ * queued remote wakeups and send them together when the batch ends.
+ */
+SCHED_FEAT(TTWU_BATCH, true)
+
 /*
  * When doing wakeups, attempt to limit superfluous scans of the LLC domain.
  */
 SCHED_FEAT(SIS_AVG_CPU, false)
 
+/*
+ * Find idle CPUs and cores for wakeups from the per-LLC idle masks
+ * instead of scanning the whole LLC domain.
+ */
+SCHED_FEAT(SIS_IDLE_MASK, true)
+
+/*
+ * Share the per-CPU sums of remote groups between CPUs load balancing at
+ * the same level within a jiffy, see struct sg_lb_cache.
+ */
+SCHED_FEAT(LB_STATS_CACHE, true)
+
 /*
  * Issue a WARN when we do multiple update_rq_clock() calls
  * in a single rq->lock section. Default disabled because the
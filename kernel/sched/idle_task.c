@@ -26,7 +26,17 @@ static void check_preempt_curr_idle(struct rq *rq, struct task_struct *p, int fl
 static struct task_struct *
 pick_next_task_idle(struct rq *rq, struct task_struct *prev, struct rq_flags *rf)
 {
-	put_prev_task(rq, prev);
+	/*
+	 * An idle -> idle reschedule is not a busy/idle transition; going
+	 * through put_prev_task_idle() would clear and re-set the idle
+	 * masks (and flip the whole core in sds_idle_cores) for nothing.
+	 */
+	if (prev == rq->idle) {
+		rq_last_tick_reset(rq);
+	} else {
+		put_prev_task(rq, prev);
+		update_idle_cpumask(rq, true);
+	}
 	update_idle_core(rq);
 	schedstat_inc(rq->sched_goidle);
 	return rq->idle;
@@ -47,6 +57,7 @@ dequeue_task_idle(struct rq *rq, struct task_struct *p, int flags)
 
 static void put_prev_task_idle(struct rq *rq, struct task_struct *prev)
 {
+	update_idle_cpumask(rq, false);
 	rq_last_tick_reset(rq);
 }
 
@@ -283,6 +283,10 @@ struct task_group {
 	/* runqueue "owned" by this group on each cpu */
 	struct cfs_rq **cfs_rq;
 	unsigned long shares;
+	/* added to the latency nice of the group's tasks */
+	int latency_nice;
+	/* sum of latency_nice over this group and its ancestors, clamped */
+	int latency_nice_eff;
 
 #ifdef	CONFIG_SMP
 	/*
@@ -312,6 +316,18 @@ struct task_group {
 	struct autogroup *autogroup;
 #endif
 
+#ifdef CONFIG_SCHED_CORE
+	/* tasks of this group and its descendants get a core cookie */
+	int core_tagged;
+#endif
+
+#ifdef CONFIG_UCLAMP_TASK
+	/* requested clamps, and the effective ones capped by the parent's */
+	unsigned int uclamp_req[UCLAMP_CNT];
+	/* range the clamp values of the group's tasks are restricted to */
+	unsigned int uclamp_eff[UCLAMP_CNT];
+#endif
+
 	struct cfs_bandwidth cfs_bandwidth;
 };
 
@@ -615,6 +631,27 @@ extern void rq_attach_root(struct rq *rq, struct root_domain *rd);
 
 #endif /* CONFIG_SMP */
 
+#ifdef CONFIG_UCLAMP_TASK
+/*
+ * RUNNABLE tasks are accounted in buckets by clamp value; each bucket
+ * tracks the highest clamp value of its tasks, which lets the rq clamp
+ * value be updated cheaply when tasks come and go.
+ */
+#define UCLAMP_BUCKETS		5
+#define UCLAMP_BUCKET_DELTA	DIV_ROUND_CLOSEST(SCHED_CAPACITY_SCALE, UCLAMP_BUCKETS)
+
+struct uclamp_bucket {
+	unsigned int value;
+	unsigned int tasks;
+};
+
+struct uclamp_rq {
+	unsigned int value;	/* max aggregated clamp of RUNNABLE tasks */
+	unsigned int nr_tasks;
+	struct uclamp_bucket bucket[UCLAMP_BUCKETS];
+};
+#endif /* CONFIG_UCLAMP_TASK */
+
 /*
  * This is the main, per-CPU runqueue data structure.
  *
@@ -651,6 +688,11 @@ struct rq {
 	unsigned long nr_load_updates;
 	u64 nr_switches;
 
+#ifdef CONFIG_UCLAMP_TASK
+	/* Utilization clamp values based on CPU's RUNNABLE tasks */
+	struct uclamp_rq uclamp[UCLAMP_CNT] ____cacheline_aligned;
+#endif
+
 	struct cfs_rq cfs;
 	struct rt_rq rt;
 	struct dl_rq dl;
@@ -746,6 +788,41 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+	/* ttwu_queue_remote() IPI stats */
+	unsigned int ttwu_ipi_sent;
+	unsigned int ttwu_ipi_mask_sent;
+	unsigned int ttwu_ipi_mask_cpus;
+	unsigned int ttwu_ipi_coalesced;
+	unsigned int ttwu_ipi_polling;
+
+	/* select_idle_sibling() stats */
+	unsigned int sis_search;
+	unsigned int sis_domain_search;
+	unsigned int sis_scanned;
+	unsigned int sis_failed;
+
+	/* core scheduling stats */
+	unsigned int core_forceidle_count;
+	unsigned long long core_forceidle_time;
+
+	/* update_blocked_averages() stats */
+	unsigned int blocked_update_count;
+	unsigned int blocked_update_scanned;
+	unsigned int blocked_update_pruned;
+	unsigned long long blocked_update_time;
+#endif
+
+#ifdef CONFIG_SCHED_CORE
+	/* core scheduling state, see sched_core_pick() */
+	unsigned int core_state;
+	unsigned long core_cookie;
+	bool core_forceidle;
+	bool core_yield;
+	bool core_exempt;
+	bool core_kick;
+	unsigned long core_wait_cookie;
+	u64 core_forceidle_start;
 #endif
 
 #ifdef CONFIG_SMP
@@ -784,6 +861,48 @@ static inline void update_idle_core(struct rq *rq)
 static inline void update_idle_core(struct rq *rq) { }
 #endif
 
+#ifdef CONFIG_UCLAMP_TASK
+/*
+ * Clamp @util, a CPU utilization, by the aggregated clamps of the tasks
+ * RUNNABLE on @rq.  A boost wins over a cap when they conflict.
+ */
+static inline unsigned long uclamp_util(struct rq *rq, unsigned long util)
+{
+	unsigned int min_util = READ_ONCE(rq->uclamp[UCLAMP_MIN].value);
+	unsigned int max_util = READ_ONCE(rq->uclamp[UCLAMP_MAX].value);
+
+	if (unlikely(min_util >= max_util))
+		return min_util;
+
+	return clamp(util, (unsigned long)min_util, (unsigned long)max_util);
+}
+#else
+static inline unsigned long uclamp_util(struct rq *rq, unsigned long util)
+{
+	return util;
+}
+#endif /* CONFIG_UCLAMP_TASK */
+
+#ifdef CONFIG_SCHED_CORE
+extern struct static_key_false __sched_core_enabled;
+
+static inline bool sched_core_enabled(void)
+{
+	return static_branch_unlikely(&__sched_core_enabled);
+}
+#else
+static inline bool sched_core_enabled(void)
+{
+	return false;
+}
+#endif
+
+#ifdef CONFIG_SMP
+extern void update_idle_cpumask(struct rq *rq, bool idle);
+#else
+static inline void update_idle_cpumask(struct rq *rq, bool idle) { }
+#endif
+
 DECLARE_PER_CPU_SHARED_ALIGNED(struct rq, runqueues);
 
 #define cpu_rq(cpu)		(&per_cpu(runqueues, (cpu)))
@@ -1014,6 +1133,28 @@ DECLARE_PER_CPU(struct sched_domain_shared *, sd_llc_shared);
 DECLARE_PER_CPU(struct sched_domain *, sd_numa);
 DECLARE_PER_CPU(struct sched_domain *, sd_asym);
 
+/*
+ * Per-CPU sums of a group gathered by update_sg_lb_stats(), kept for the
+ * rest of the jiffy so that CPUs balancing at the same level (notably the
+ * NOHZ idle balancer doing it on behalf of all idle CPUs) can share them.
+ */
+struct sg_lb_cache {
+	raw_spinlock_t lock;		/* serializes updaters */
+	seqcount_t seq;
+	unsigned long stamp;		/* jiffies of the last update */
+	int load_idx;			/* source_load() index used */
+	bool overload;
+	unsigned long group_load;
+	unsigned long group_util;
+	unsigned long sum_weighted_load;
+	unsigned int sum_nr_running;
+	unsigned int idle_cpus;
+#ifdef CONFIG_NUMA_BALANCING
+	unsigned int nr_numa_running;
+	unsigned int nr_preferred_running;
+#endif
+};
+
 struct sched_group_capacity {
 	atomic_t ref;
 	/*
@@ -1025,6 +1166,8 @@ struct sched_group_capacity {
 	unsigned long next_update;
 	int imbalance; /* XXX unrelated to capacity but shared group state */
 
+	struct sg_lb_cache lb_cache;
+
 	unsigned long cpumask[0]; /* iteration mask */
 };
 
@@ -1141,6 +1284,21 @@ static inline struct task_group *task_group(struct task_struct *p)
 
 #endif /* CONFIG_CGROUP_SCHED */
 
+/*
+ * The latency nice value the scheduler acts on: the task's own value,
+ * offset by those of its task group and all of the group's ancestors.
+ */
+static inline int task_latency_nice(struct task_struct *p)
+{
+	int latency_nice = p->latency_nice;
+
+#ifdef CONFIG_FAIR_GROUP_SCHED
+	latency_nice += READ_ONCE(task_group(p)->latency_nice_eff);
+	latency_nice = clamp(latency_nice, MIN_LATENCY_NICE, MAX_LATENCY_NICE);
+#endif
+	return latency_nice;
+}
+
 static inline void __set_task_cpu(struct task_struct *p, unsigned int cpu)
 {
 	set_task_rq(p, cpu);
@@ -1905,6 +2063,8 @@ show_numa_stats(struct task_struct *p, struct seq_file *m);
 extern void
 print_numa_stats(struct seq_file *m, int node, unsigned long tsf,
 	unsigned long tpf, unsigned long gsf, unsigned long gpf);
+extern void
+print_numa_sampled_stats(struct seq_file *m, int node, unsigned long pages);
 #endif /* CONFIG_NUMA_BALANCING */
 #endif /* CONFIG_SCHED_DEBUG */
 
@@ -10,7 +10,7 @@
  * bump this up when changing the output format or the meaning of an existing
  * format, so that tools can adapt (or abort)
  */
-#define SCHEDSTAT_VERSION 15
+#define SCHEDSTAT_VERSION 20
 
 static int show_schedstat(struct seq_file *seq, void *v)
 {
@@ -30,12 +30,21 @@ static int show_schedstat(struct seq_file *seq, void *v)
 
 		/* runqueue-specific stats */
 		seq_printf(seq,
-		    "cpu%d %u 0 %u %u %u %u %llu %llu %lu",
+		    "cpu%d %u 0 %u %u %u %u %llu %llu %lu %u %u %u %u %u %llu"
+		    " %u %u %u %llu %u %u %u %u %u",
 		    cpu, rq->yld_count,
 		    rq->sched_count, rq->sched_goidle,
 		    rq->ttwu_count, rq->ttwu_local,
 		    rq->rq_cpu_time,
-		    rq->rq_sched_info.run_delay, rq->rq_sched_info.pcount);
+		    rq->rq_sched_info.run_delay, rq->rq_sched_info.pcount,
+		    rq->sis_search, rq->sis_domain_search,
+		    rq->sis_scanned, rq->sis_failed,
+		    rq->core_forceidle_count, rq->core_forceidle_time,
+		    rq->blocked_update_count, rq->blocked_update_scanned,
+		    rq->blocked_update_pruned, rq->blocked_update_time,
+		    rq->ttwu_ipi_sent, rq->ttwu_ipi_mask_sent,
+		    rq->ttwu_ipi_mask_cpus, rq->ttwu_ipi_coalesced,
+		    rq->ttwu_ipi_polling);
 
 		seq_printf(seq, "\n");
 
@@ -60,12 +69,13 @@ static int show_schedstat(struct seq_file *seq, void *v)
 				    sd->lb_nobusyg[itype]);
 			}
 			seq_printf(seq,
-				   " %u %u %u %u %u %u %u %u %u %u %u %u\n",
+				   " %u %u %u %u %u %u %u %u %u %u %u %u %u %u %llu\n",
 			    sd->alb_count, sd->alb_failed, sd->alb_pushed,
 			    sd->sbe_count, sd->sbe_balanced, sd->sbe_pushed,
 			    sd->sbf_count, sd->sbf_balanced, sd->sbf_pushed,
 			    sd->ttwu_wake_remote, sd->ttwu_move_affine,
-			    sd->ttwu_move_balance);
+			    sd->ttwu_move_balance,
+			    sd->lb_sgs_hit, sd->lb_sgs_miss, sd->lb_stats_time);
 		}
 		rcu_read_unlock();
 #endif
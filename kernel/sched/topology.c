@@ -392,6 +392,20 @@ static void update_top_cache_domain(int cpu)
 	per_cpu(sd_llc_id, cpu) = id;
 	rcu_assign_pointer(per_cpu(sd_llc_shared, cpu), sds);
 
+	/*
+	 * The idle masks of a new domain start out empty; CPUs sitting
+	 * in idle won't pass through idle entry again to fill them in.
+	 */
+	if (sds && idle_cpu(cpu)) {
+		cpumask_set_cpu(cpu, sds_idle_cpus(sds));
+#ifdef CONFIG_SCHED_SMT
+		/* The last idle sibling to attach completes the core. */
+		if (cpumask_subset(cpu_smt_mask(cpu), sds_idle_cpus(sds)))
+			cpumask_or(sds_idle_cores(sds), sds_idle_cores(sds),
+				   cpu_smt_mask(cpu));
+#endif
+	}
+
 	sd = lowest_flag_domain(cpu, SD_NUMA);
 	rcu_assign_pointer(per_cpu(sd_numa, cpu), sd);
 
@@ -1287,7 +1301,8 @@ static int __sdt_alloc(const struct cpumask *cpu_map)
 
 			*per_cpu_ptr(sdd->sd, j) = sd;
 
-			sds = kzalloc_node(sizeof(struct sched_domain_shared),
+			sds = kzalloc_node(sizeof(struct sched_domain_shared) +
+					2 * cpumask_size(),
 					GFP_KERNEL, cpu_to_node(j));
 			if (!sds)
 				return -ENOMEM;
@@ -1308,6 +1323,10 @@ static int __sdt_alloc(const struct cpumask *cpu_map)
 			if (!sgc)
 				return -ENOMEM;
 
+			raw_spin_lock_init(&sgc->lb_cache.lock);
+			seqcount_init(&sgc->lb_cache.seq);
+			sgc->lb_cache.load_idx = -1;
+
 			*per_cpu_ptr(sdd->sgc, j) = sgc;
 		}
 	}
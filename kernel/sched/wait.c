@@ -7,6 +7,7 @@
 #include <linux/export.h>
 #include <linux/sched/signal.h>
 #include <linux/sched/debug.h>
+#include <linux/sched/wake_q.h>
 #include <linux/mm.h>
 #include <linux/wait.h>
 #include <linux/hash.h>
@@ -91,10 +92,15 @@ void __wake_up(wait_queue_head_t *q, unsigned int mode,
 			int nr_exclusive, void *key)
 {
 	unsigned long flags;
+	bool batch = false;
 
+	/* Only wake-all calls can wake enough tasks to be worth batching */
+	if (!nr_exclusive)
+		batch = ttwu_batch_begin();
 	spin_lock_irqsave(&q->lock, flags);
 	__wake_up_common(q, mode, nr_exclusive, 0, key);
 	spin_unlock_irqrestore(&q->lock, flags);
+	ttwu_batch_end(batch);
 }
 EXPORT_SYMBOL(__wake_up);
 
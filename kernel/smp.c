@@ -34,6 +34,35 @@ struct call_function_data {
 
 static DEFINE_PER_CPU_SHARED_ALIGNED(struct call_function_data, cfd_data);
 
+/*
+ * Broadcast mode of smp_call_function_many(): rather than queueing one csd
+ * on each target, the initiator fills in its (single) call_function_bcast
+ * and sets its own bit in cfd_bcast_active. The IPI handler scans the
+ * active initiators for descriptors with its bit set in ->pending, runs
+ * the function and acknowledges by clearing that bit. ->pending doubles as
+ * the lock of the descriptor: it can be reused once it is empty. Bits in
+ * cfd_bcast_active are never cleared, idle descriptors are skipped by
+ * looking at ->pending.
+ */
+struct call_function_bcast {
+	smp_call_func_t		func;
+	void			*info;
+	unsigned int		flags;
+	cpumask_var_t		pending;
+};
+
+static DEFINE_PER_CPU_SHARED_ALIGNED(struct call_function_bcast, cfd_bcast);
+static struct cpumask cfd_bcast_active;
+
+/* minimum number of targets to use broadcast mode for, 0 means never */
+static unsigned int smp_call_bcast_min __read_mostly;
+
+static int __init smp_call_broadcast_setup(char *str)
+{
+	return kstrtouint(str, 0, &smp_call_bcast_min);
+}
+early_param("smp_call_broadcast", smp_call_broadcast_setup);
+
 static DEFINE_PER_CPU_SHARED_ALIGNED(struct llist_head, call_single_queue);
 
 static void flush_smp_call_function_queue(bool warn_cpu_offline);
@@ -82,8 +111,15 @@ void __init call_function_init(void)
 {
 	int i;
 
-	for_each_possible_cpu(i)
+	for_each_possible_cpu(i) {
 		init_llist_head(&per_cpu(call_single_queue, i));
+		/*
+		 * Never freed: the IPI handler may look at the descriptor of
+		 * any initiator that ever broadcast, online or not.
+		 */
+		BUG_ON(!zalloc_cpumask_var_node(&per_cpu(cfd_bcast, i).pending,
+						GFP_KERNEL, cpu_to_node(i)));
+	}
 
 	smpcfd_prepare_cpu(smp_processor_id());
 }
@@ -125,6 +161,51 @@ static __always_inline void csd_unlock(struct call_single_data *csd)
 
 static DEFINE_PER_CPU_SHARED_ALIGNED(struct call_single_data, csd_data);
 
+/*
+ * Wait for all targets of the previous broadcast from this CPU to have
+ * acknowledged it; for synchronous broadcasts this also means they have
+ * finished running the function.
+ */
+static void bcast_wait(struct call_function_bcast *bcast)
+{
+	while (!cpumask_empty(bcast->pending))
+		cpu_relax();
+	/* order the acknowledgements against whatever we do next */
+	smp_mb();
+}
+
+/*
+ * Run the broadcasts published for this CPU. Called from the IPI handler
+ * with interrupts disabled, after the queued csds.
+ */
+static void flush_smp_call_function_bcast(void)
+{
+	int this_cpu = smp_processor_id();
+	int cpu;
+
+	for_each_cpu(cpu, &cfd_bcast_active) {
+		struct call_function_bcast *bcast = &per_cpu(cfd_bcast, cpu);
+		smp_call_func_t func;
+		void *info;
+
+		if (!cpumask_test_cpu(this_cpu, bcast->pending))
+			continue;
+
+		/* pairs with the smp_wmb() in smp_call_function_bcast() */
+		smp_rmb();
+		func = bcast->func;
+		info = bcast->info;
+
+		if (bcast->flags & CSD_FLAG_SYNCHRONOUS) {
+			func(info);
+			clear_bit_unlock(this_cpu, cpumask_bits(bcast->pending));
+		} else {
+			clear_bit_unlock(this_cpu, cpumask_bits(bcast->pending));
+			func(info);
+		}
+	}
+}
+
 /*
  * Insert a previously allocated call_single_data element
  * for execution on the given CPU. data must already have
@@ -240,6 +321,8 @@ static void flush_smp_call_function_queue(bool warn_cpu_offline)
 		}
 	}
 
+	flush_smp_call_function_bcast();
+
 	/*
 	 * Handle irq works queued remotely by irq_work_queue_on().
 	 * Smp functions above are typically synchronous so they
@@ -376,25 +459,46 @@ call:
 }
 EXPORT_SYMBOL_GPL(smp_call_function_any);
 
-/**
- * smp_call_function_many(): Run a function on a set of other CPUs.
- * @mask: The set of cpus to run on (only runs on online subset).
- * @func: The function to run. This must be fast and non-blocking.
- * @info: An arbitrary pointer to pass to the function.
- * @wait: If true, wait (atomically) until function has completed
- *        on other CPUs.
- *
- * If @wait is true, then returns once @func has returned.
- *
- * You must not call this function with disabled interrupts or from a
- * hardware interrupt handler or from a bottom half handler. Preemption
- * must be disabled when calling this function.
+/*
+ * Publish @func on the broadcast descriptor of this CPU for the CPUs in
+ * @mask and kick them. The initiator touches one descriptor however many
+ * targets there are, and the targets share its cachelines read-mostly
+ * instead of each pulling in a csd of its own.
  */
-void smp_call_function_many(const struct cpumask *mask,
-			    smp_call_func_t func, void *info, bool wait)
+static void smp_call_function_bcast(const struct cpumask *mask,
+				    smp_call_func_t func, void *info, bool wait)
+{
+	struct call_function_bcast *bcast = this_cpu_ptr(&cfd_bcast);
+	int this_cpu = smp_processor_id();
+
+	/* an asynchronous broadcast may still be in flight */
+	bcast_wait(bcast);
+
+	bcast->func = func;
+	bcast->info = info;
+	bcast->flags = wait ? CSD_FLAG_SYNCHRONOUS : 0;
+	/* pairs with the smp_rmb() in flush_smp_call_function_bcast() */
+	smp_wmb();
+	cpumask_copy(bcast->pending, mask);
+
+	if (!cpumask_test_cpu(this_cpu, &cfd_bcast_active))
+		cpumask_set_cpu(this_cpu, &cfd_bcast_active);
+	/* make the descriptor visible before the IPI goes out */
+	smp_mb();
+
+	arch_send_call_function_ipi_mask(mask);
+
+	if (wait)
+		bcast_wait(bcast);
+}
+
+static void __smp_call_function_many(const struct cpumask *mask,
+				     smp_call_func_t func, void *info,
+				     bool wait, unsigned int bcast_min)
 {
 	struct call_function_data *cfd;
 	int cpu, next_cpu, this_cpu = smp_processor_id();
+	unsigned int nr_cpus;
 
 	/*
 	 * Can deadlock when called with interrupts disabled.
@@ -420,7 +524,7 @@ void smp_call_function_many(const struct cpumask *mask,
 		next_cpu = cpumask_next_and(next_cpu, mask, cpu_online_mask);
 
 	/* Fastpath: do that cpu by itself. */
-	if (next_cpu >= nr_cpu_ids) {
+	if (next_cpu >= nr_cpu_ids && bcast_min != 1) {
 		smp_call_function_single(cpu, func, info, wait);
 		return;
 	}
@@ -431,9 +535,15 @@ void smp_call_function_many(const struct cpumask *mask,
 	cpumask_clear_cpu(this_cpu, cfd->cpumask);
 
 	/* Some callers race with other cpus changing the passed mask */
-	if (unlikely(!cpumask_weight(cfd->cpumask)))
+	nr_cpus = cpumask_weight(cfd->cpumask);
+	if (unlikely(!nr_cpus))
 		return;
 
+	if (bcast_min && nr_cpus >= bcast_min) {
+		smp_call_function_bcast(cfd->cpumask, func, info, wait);
+		return;
+	}
+
 	for_each_cpu(cpu, cfd->cpumask) {
 		struct call_single_data *csd = per_cpu_ptr(cfd->csd, cpu);
 
@@ -457,8 +567,50 @@ void smp_call_function_many(const struct cpumask *mask,
 		}
 	}
 }
+
+/**
+ * smp_call_function_many(): Run a function on a set of other CPUs.
+ * @mask: The set of cpus to run on (only runs on online subset).
+ * @func: The function to run. This must be fast and non-blocking.
+ * @info: An arbitrary pointer to pass to the function.
+ * @wait: If true, wait (atomically) until function has completed
+ *        on other CPUs.
+ *
+ * If @wait is true, then returns once @func has returned.
+ *
+ * Calls targeting at least "smp_call_broadcast=" CPUs go through a single
+ * shared descriptor rather than one csd per target.
+ *
+ * You must not call this function with disabled interrupts or from a
+ * hardware interrupt handler or from a bottom half handler. Preemption
+ * must be disabled when calling this function.
+ */
+void smp_call_function_many(const struct cpumask *mask,
+			    smp_call_func_t func, void *info, bool wait)
+{
+	__smp_call_function_many(mask, func, info, wait, smp_call_bcast_min);
+}
 EXPORT_SYMBOL(smp_call_function_many);
 
+/**
+ * smp_call_function_broadcast(): Run a function on a set of other CPUs,
+ * always using the shared broadcast descriptor.
+ * @mask: The set of cpus to run on (only runs on online subset).
+ * @func: The function to run. This must be fast and non-blocking.
+ * @info: An arbitrary pointer to pass to the function.
+ * @wait: If true, wait (atomically) until function has completed
+ *        on other CPUs.
+ *
+ * Same rules as smp_call_function_many(); mostly useful to compare the
+ * two modes.
+ */
+void smp_call_function_broadcast(const struct cpumask *mask,
+				 smp_call_func_t func, void *info, bool wait)
+{
+	__smp_call_function_many(mask, func, info, wait, 1);
+}
+EXPORT_SYMBOL_GPL(smp_call_function_broadcast);
+
 /**
  * smp_call_function(): Run a function on all other CPUs.
  * @func: The function to run. This must be fast and non-blocking.
@@ -551,20 +703,13 @@ void __init setup_nr_cpu_ids(void)
 void __init smp_init(void)
 {
 	int num_nodes, num_cpus;
-	unsigned int cpu;
 
 	idle_threads_init();
 	cpuhp_threads_init();
 
 	pr_info("Bringing up secondary CPUs ...\n");
 
-	/* FIXME: This should be done in userspace --RR */
-	for_each_present_cpu(cpu) {
-		if (num_online_cpus() >= setup_max_cpus)
-			break;
-		if (!cpu_online(cpu))
-			cpu_up(cpu);
-	}
+	bringup_nonboot_cpus(setup_max_cpus);
 
 	num_nodes = num_online_nodes();
 	num_cpus  = num_online_cpus();
@@ -15,12 +15,14 @@
 #include <linux/interrupt.h>
 #include <linux/init.h>
 #include <linux/mm.h>
+#include <linux/moduleparam.h>
 #include <linux/notifier.h>
 #include <linux/percpu.h>
 #include <linux/cpu.h>
 #include <linux/freezer.h>
 #include <linux/kthread.h>
 #include <linux/rcupdate.h>
+#include <linux/sched/clock.h>
 #include <linux/ftrace.h>
 #include <linux/smp.h>
 #include <linux/smpboot.h>
@@ -78,13 +80,23 @@ static void wakeup_softirqd(void)
 }
 
 /*
- * If ksoftirqd is scheduled, we do not want to process pending softirqs
- * right now. Let ksoftirqd handle this at its own rate, to get fairness.
+ * Vectors left to ksoftirqd: they are not processed on irq exit or
+ * local_bh_enable() until ksoftirqd has run, see __do_softirq().
  */
-static bool ksoftirqd_running(void)
+static DEFINE_PER_CPU(__u32, softirq_deferred);
+
+/*
+ * If ksoftirqd is scheduled to process the @pending softirqs, we do not
+ * want to process them right now. Let ksoftirqd handle this at its own
+ * rate, to get fairness. Vectors which have not been left to it are still
+ * processed inline.
+ */
+static bool ksoftirqd_running(__u32 pending)
 {
 	struct task_struct *tsk = __this_cpu_read(ksoftirqd);
 
+	if (pending & ~__this_cpu_read(softirq_deferred))
+		return false;
 	return tsk && (tsk->state == TASK_RUNNING);
 }
 
@@ -205,6 +217,23 @@ EXPORT_SYMBOL(__local_bh_enable_ip);
 #define MAX_SOFTIRQ_TIME  msecs_to_jiffies(2)
 #define MAX_SOFTIRQ_RESTART 10
 
+/*
+ * Within these limits, each vector also has a time budget per
+ * __do_softirq() invocation. A vector exceeding it is left to ksoftirqd,
+ * while the other vectors keep being processed inline. 0 means no budget.
+ */
+static unsigned int softirq_budget_us[NR_SOFTIRQS] = {
+	[0 ... NR_SOFTIRQS - 1] = 2000,
+};
+module_param_array_named(budget_us, softirq_budget_us, uint, NULL, 0644);
+
+static inline bool softirq_over_budget(unsigned int vec_nr, u64 used)
+{
+	unsigned int budget = READ_ONCE(softirq_budget_us[vec_nr]);
+
+	return budget && used > (u64)budget * NSEC_PER_USEC;
+}
+
 #ifdef CONFIG_TRACE_IRQFLAGS
 /*
  * When we run softirqs from irq_exit() and thus on the hardirq stack we need
@@ -243,9 +272,11 @@ asmlinkage __visible void __softirq_entry __do_softirq(void)
 	unsigned long end = jiffies + MAX_SOFTIRQ_TIME;
 	unsigned long old_flags = current->flags;
 	int max_restart = MAX_SOFTIRQ_RESTART;
+	struct task_struct *tsk = __this_cpu_read(ksoftirqd);
+	u64 used[NR_SOFTIRQS] = { 0 };
 	struct softirq_action *h;
+	__u32 pending, deferred;
 	bool in_hardirq;
-	__u32 pending;
 	int softirq_bit;
 
 	/*
@@ -256,14 +287,19 @@ asmlinkage __visible void __softirq_entry __do_softirq(void)
 	current->flags &= ~PF_MEMALLOC;
 
 	pending = local_softirq_pending();
+	deferred = __this_cpu_read(softirq_deferred);
 	account_irq_enter_time(current);
 
 	__local_bh_disable_ip(_RET_IP_, SOFTIRQ_OFFSET);
 	in_hardirq = lockdep_softirq_start();
 
 restart:
-	/* Reset the pending bitmask before enabling irqs */
-	set_softirq_pending(0);
+	/*
+	 * Reset the pending bitmask before enabling irqs, except for the
+	 * vectors left to ksoftirqd.
+	 */
+	set_softirq_pending(pending & deferred);
+	pending &= ~deferred;
 
 	local_irq_enable();
 
@@ -272,6 +308,7 @@ restart:
 	while ((softirq_bit = ffs(pending))) {
 		unsigned int vec_nr;
 		int prev_count;
+		u64 start, delta;
 
 		h += softirq_bit - 1;
 
@@ -281,7 +318,9 @@ restart:
 		kstat_incr_softirqs_this_cpu(vec_nr);
 
 		trace_softirq_entry(vec_nr);
+		start = local_clock();
 		h->action(h);
+		delta = local_clock() - start;
 		trace_softirq_exit(vec_nr);
 		if (unlikely(prev_count != preempt_count())) {
 			pr_err("huh, entered softirq %u %s %p with preempt_count %08x, exited with %08x?\n",
@@ -289,6 +328,16 @@ restart:
 			       prev_count, preempt_count());
 			preempt_count_set(prev_count);
 		}
+
+		kstat_add_softirq_time_this_cpu(vec_nr, delta);
+		used[vec_nr] += delta;
+		/* budgets only apply when ksoftirqd can take over */
+		if (tsk && current != tsk &&
+		    softirq_over_budget(vec_nr, used[vec_nr])) {
+			deferred |= 1U << vec_nr;
+			trace_softirq_defer(vec_nr);
+		}
+
 		h++;
 		pending >>= softirq_bit;
 	}
@@ -298,12 +347,17 @@ restart:
 
 	pending = local_softirq_pending();
 	if (pending) {
-		if (time_before(jiffies, end) && !need_resched() &&
-		    --max_restart)
+		if ((pending & ~deferred) && time_before(jiffies, end) &&
+		    !need_resched() && --max_restart)
 			goto restart;
 
+		/* out of time or restarts, leave everything to ksoftirqd */
+		if (tsk)
+			deferred |= pending;
 		wakeup_softirqd();
 	}
+	/* Vectors handled meanwhile are no longer deferred to ksoftirqd */
+	__this_cpu_write(softirq_deferred, deferred & local_softirq_pending());
 
 	lockdep_softirq_end(in_hardirq);
 	account_irq_exit_time(current);
@@ -324,7 +378,7 @@ asmlinkage __visible void do_softirq(void)
 
 	pending = local_softirq_pending();
 
-	if (pending && !ksoftirqd_running())
+	if (pending && !ksoftirqd_running(pending))
 		do_softirq_own_stack();
 
 	local_irq_restore(flags);
@@ -351,7 +405,7 @@ void irq_enter(void)
 
 static inline void invoke_softirq(void)
 {
-	if (ksoftirqd_running())
+	if (ksoftirqd_running(local_softirq_pending()))
 		return;
 
 	if (!force_irqthreads) {
@@ -669,6 +723,8 @@ static void run_ksoftirqd(unsigned int cpu)
 {
 	local_irq_disable();
 	if (local_softirq_pending()) {
+		/* everything left to us is being processed now */
+		__this_cpu_write(softirq_deferred, 0);
 		/*
 		 * We can safely run softirq on inline stack, as we are not deep
 		 * in the task stack here.
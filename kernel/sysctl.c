@@ -390,6 +390,17 @@ static struct ctl_table kern_table[] = {
 		.proc_handler	= proc_dointvec_minmax,
 		.extra1		= &one,
 	},
+#ifdef CONFIG_IDLE_PAGE_TRACKING
+	{
+		.procname	= "numa_balancing_scan_sampling",
+		.data		= &sysctl_numa_balancing_scan_sampling,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+#endif
 	{
 		.procname	= "numa_balancing",
 		.data		= NULL, /* filled in by handler */
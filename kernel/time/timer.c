@@ -44,6 +44,11 @@
 #include <linux/sched/debug.h>
 #include <linux/slab.h>
 #include <linux/compat.h>
+#include <linux/debug_stats.h>
+#include <linux/debugfs.h>
+#include <linux/kthread.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
 
 #include <linux/uaccess.h>
 #include <asm/unistd.h>
@@ -203,12 +208,87 @@ struct timer_base {
 	bool			migration_enabled;
 	bool			nohz_active;
 	bool			is_idle;
+#ifdef CONFIG_TIMER_BATCH
+	struct timer_list	*offload_running;
+	struct hlist_head	overflow;
+#endif
 	DECLARE_BITMAP(pending_map, WHEEL_SIZE);
 	struct hlist_head	vectors[WHEEL_SIZE];
 } ____cacheline_aligned;
 
 static DEFINE_PER_CPU(struct timer_base, timer_bases[NR_BASES]);
 
+#ifdef CONFIG_TIMER_BATCH
+/*
+ * Batched expiry of TIMER_BATCHABLE timers.
+ *
+ * With batching enabled, the expiry of batchable timers is rounded up to
+ * a slack window, so that they end up expiring in the same tick, and one
+ * run of the timer softirq expires at most timer_batch_max of them. The
+ * ones left over are moved to base->overflow, where they stay pending, and
+ * expired by the kthread of the node of the base, in batches of the same
+ * size. While the kthread runs a timer, base->offload_running points to
+ * it, which del_timer_sync() and the migration in __mod_timer() check
+ * along with base->running_timer.
+ */
+static DEFINE_STATIC_KEY_FALSE(timer_batch_key);
+static unsigned int timer_batch_max = 64;
+static unsigned long timer_batch_slack_mask;
+static bool timer_batch_boot_enable;
+
+/* timer softirq duration histogram, see debug_stats_log2_bucket() */
+#define TIMER_BATCH_HIST	16
+
+struct timer_batch_stats {
+	unsigned long		runs;
+	unsigned long		offloaded;
+	u64			max_ns;
+	unsigned int		hist[TIMER_BATCH_HIST];
+};
+
+static DEFINE_PER_CPU(struct timer_batch_stats, timer_batch_stats);
+
+struct timer_batch_node {
+	struct task_struct	*task;
+	unsigned long		expired;
+};
+
+static struct timer_batch_node *timer_batch_nodes;
+
+/* wheel index of a timer on base->overflow */
+#define TIMER_BATCH_IDX		WHEEL_SIZE
+
+static inline unsigned long timer_batch_slack(struct timer_list *timer,
+					      unsigned long expires)
+{
+	if (static_branch_unlikely(&timer_batch_key) &&
+	    (timer->flags & TIMER_BATCHABLE))
+		expires = (expires + timer_batch_slack_mask) &
+			  ~timer_batch_slack_mask;
+	return expires;
+}
+
+static inline bool timer_running(struct timer_base *base,
+				 struct timer_list *timer)
+{
+	return base->running_timer == timer || base->offload_running == timer;
+}
+#else
+#define TIMER_BATCH_IDX		WHEEL_SIZE
+
+static inline unsigned long timer_batch_slack(struct timer_list *timer,
+					      unsigned long expires)
+{
+	return expires;
+}
+
+static inline bool timer_running(struct timer_base *base,
+				 struct timer_list *timer)
+{
+	return base->running_timer == timer;
+}
+#endif /* CONFIG_TIMER_BATCH */
+
 #if defined(CONFIG_SMP) && defined(CONFIG_NO_HZ_COMMON)
 unsigned int sysctl_timer_migration = 1;
 
@@ -801,7 +881,8 @@ static int detach_if_pending(struct timer_list *timer, struct timer_base *base,
 	if (!timer_pending(timer))
 		return 0;
 
-	if (hlist_is_singular_node(&timer->entry, base->vectors + idx))
+	if (idx != TIMER_BATCH_IDX &&
+	    hlist_is_singular_node(&timer->entry, base->vectors + idx))
 		__clear_bit(idx, base->pending_map);
 
 	detach_timer(timer, clear_pending);
@@ -932,6 +1013,8 @@ __mod_timer(struct timer_list *timer, unsigned long expires, bool pending_only)
 
 	BUG_ON(!timer->function);
 
+	expires = timer_batch_slack(timer, expires);
+
 	/*
 	 * This is a common optimization triggered by the networking code - if
 	 * the timer is re-modified to have the same timeout or ends up in the
@@ -982,7 +1065,7 @@ __mod_timer(struct timer_list *timer, unsigned long expires, bool pending_only)
 		 * handler yet has not finished. This also guarantees that the
 		 * timer is serialized wrt itself.
 		 */
-		if (likely(base->running_timer != timer)) {
+		if (likely(!timer_running(base, timer))) {
 			/* See the comment in lock_timer_base() */
 			timer->flags |= TIMER_MIGRATING;
 
@@ -1165,7 +1248,7 @@ int try_to_del_timer_sync(struct timer_list *timer)
 
 	base = lock_timer_base(timer, &flags);
 
-	if (base->running_timer != timer)
+	if (!timer_running(base, timer))
 		ret = detach_if_pending(timer, base, true);
 
 	spin_unlock_irqrestore(&base->lock, flags);
@@ -1283,7 +1366,89 @@ static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 	}
 }
 
-static void expire_timers(struct timer_base *base, struct hlist_head *head)
+#ifdef CONFIG_TIMER_BATCH
+/*
+ * Called for each timer due in the timer softirq: returns true if @timer
+ * was moved to the overflow list instead, once @budget is used up.
+ */
+static inline bool timer_batch_defer(struct timer_base *base,
+				     struct timer_list *timer,
+				     unsigned int *budget)
+{
+	if ((timer->flags & (TIMER_BATCHABLE | TIMER_PINNED)) !=
+	    TIMER_BATCHABLE)
+		return false;
+
+	if (*budget) {
+		(*budget)--;
+		return false;
+	}
+
+	__hlist_del(&timer->entry);
+	hlist_add_head(&timer->entry, &base->overflow);
+	timer_set_idx(timer, TIMER_BATCH_IDX);
+	__this_cpu_inc(timer_batch_stats.offloaded);
+	return true;
+}
+
+/* How many batchable timers one run of the softirq expires on @base */
+static inline unsigned int timer_batch_budget(struct timer_base *base)
+{
+	if (!static_branch_unlikely(&timer_batch_key) ||
+	    !timer_batch_nodes[cpu_to_node(base->cpu)].task)
+		return UINT_MAX;
+	return timer_batch_max;
+}
+
+static void timer_batch_kick(struct timer_base *base)
+{
+	if (!hlist_empty(&base->overflow))
+		wake_up_process(timer_batch_nodes[cpu_to_node(base->cpu)].task);
+}
+
+static inline u64 timer_batch_begin(void)
+{
+	if (static_branch_unlikely(&timer_batch_key))
+		return local_clock();
+	return 0;
+}
+
+static void timer_batch_end(u64 start)
+{
+	struct timer_batch_stats *st;
+	u64 delta;
+
+	if (!start)
+		return;
+
+	delta = local_clock() - start;
+
+	st = this_cpu_ptr(&timer_batch_stats);
+	st->runs++;
+	st->hist[debug_stats_log2_bucket(delta, TIMER_BATCH_HIST)]++;
+	if (delta > st->max_ns)
+		st->max_ns = delta;
+}
+#else
+static inline bool timer_batch_defer(struct timer_base *base,
+				     struct timer_list *timer,
+				     unsigned int *budget)
+{
+	return false;
+}
+
+static inline unsigned int timer_batch_budget(struct timer_base *base)
+{
+	return UINT_MAX;
+}
+
+static inline void timer_batch_kick(struct timer_base *base) { }
+static inline u64 timer_batch_begin(void) { return 0; }
+static inline void timer_batch_end(u64 start) { }
+#endif
+
+static void expire_timers(struct timer_base *base, struct hlist_head *head,
+			  unsigned int *budget)
 {
 	while (!hlist_empty(head)) {
 		struct timer_list *timer;
@@ -1292,6 +1457,9 @@ static void expire_timers(struct timer_base *base, struct hlist_head *head)
 
 		timer = hlist_entry(head->first, struct timer_list, entry);
 
+		if (timer_batch_defer(base, timer, budget))
+			continue;
+
 		base->running_timer = timer;
 		detach_timer(timer, true);
 
@@ -1585,11 +1753,14 @@ void update_process_times(int user_tick)
 static inline void __run_timers(struct timer_base *base)
 {
 	struct hlist_head heads[LVL_DEPTH];
+	unsigned int budget;
 	int levels;
 
 	if (!time_after_eq(jiffies, base->clk))
 		return;
 
+	budget = timer_batch_budget(base);
+
 	spin_lock_irq(&base->lock);
 
 	while (time_after_eq(jiffies, base->clk)) {
@@ -1598,10 +1769,12 @@ static inline void __run_timers(struct timer_base *base)
 		base->clk++;
 
 		while (levels--)
-			expire_timers(base, heads + levels);
+			expire_timers(base, heads + levels, &budget);
 	}
 	base->running_timer = NULL;
 	spin_unlock_irq(&base->lock);
+
+	timer_batch_kick(base);
 }
 
 /*
@@ -1610,10 +1783,13 @@ static inline void __run_timers(struct timer_base *base)
 static __latent_entropy void run_timer_softirq(struct softirq_action *h)
 {
 	struct timer_base *base = this_cpu_ptr(&timer_bases[BASE_STD]);
+	u64 start = timer_batch_begin();
 
 	__run_timers(base);
 	if (IS_ENABLED(CONFIG_NO_HZ_COMMON) && base->nohz_active)
 		__run_timers(this_cpu_ptr(&timer_bases[BASE_DEF]));
+
+	timer_batch_end(start);
 }
 
 /*
@@ -1636,6 +1812,243 @@ void run_local_timers(void)
 	raise_softirq(TIMER_SOFTIRQ);
 }
 
+#ifdef CONFIG_TIMER_BATCH
+/*
+ * Expire up to timer_batch_max timers of the overflow list of @base, the
+ * way expire_timers() does, but with base->offload_running marking the
+ * running timer. Returns the number of timers expired.
+ */
+static unsigned int timer_batch_expire(struct timer_base *base)
+{
+	unsigned int n = 0, limit = max(timer_batch_max, 1U);
+
+	if (hlist_empty(&base->overflow))
+		return 0;
+
+	/* timer callbacks expect to run with bottom halves disabled */
+	local_bh_disable();
+	spin_lock_irq(&base->lock);
+	while (!hlist_empty(&base->overflow) && n < limit) {
+		struct timer_list *timer;
+		void (*fn)(unsigned long);
+		unsigned long data;
+
+		timer = hlist_entry(base->overflow.first, struct timer_list,
+				    entry);
+
+		base->offload_running = timer;
+		detach_timer(timer, true);
+
+		fn = timer->function;
+		data = timer->data;
+
+		if (timer->flags & TIMER_IRQSAFE) {
+			spin_unlock(&base->lock);
+			call_timer_fn(timer, fn, data);
+			spin_lock(&base->lock);
+		} else {
+			spin_unlock_irq(&base->lock);
+			call_timer_fn(timer, fn, data);
+			spin_lock_irq(&base->lock);
+		}
+		n++;
+	}
+	base->offload_running = NULL;
+	spin_unlock_irq(&base->lock);
+	local_bh_enable();
+
+	return n;
+}
+
+static bool timer_batch_pending(int node)
+{
+	int cpu, b;
+
+	for_each_cpu(cpu, cpumask_of_node(node)) {
+		if (!cpu_online(cpu))
+			continue;
+		for (b = 0; b < NR_BASES; b++) {
+			if (!hlist_empty(&per_cpu_ptr(&timer_bases[b], cpu)->overflow))
+				return true;
+		}
+	}
+	return false;
+}
+
+static int timer_batch_thread(void *data)
+{
+	struct timer_batch_node *tbn = data;
+	int node = tbn - timer_batch_nodes;
+	const struct cpumask *mask = cpumask_of_node(node);
+
+	if (!cpumask_empty(mask))
+		set_cpus_allowed_ptr(current, mask);
+
+	for (;;) {
+		int cpu, b;
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!timer_batch_pending(node)) {
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+
+		/*
+		 * Leave the overflow of a CPU going down alone: it is moved
+		 * back into a wheel by timers_dead_cpu(), which can't run
+		 * while we hold the hotplug lock.
+		 */
+		get_online_cpus();
+		for_each_cpu(cpu, mask) {
+			if (!cpu_online(cpu))
+				continue;
+			for (b = 0; b < NR_BASES; b++)
+				tbn->expired += timer_batch_expire(
+					per_cpu_ptr(&timer_bases[b], cpu));
+		}
+		put_online_cpus();
+
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static DEFINE_MUTEX(timer_batch_mutex);
+
+static int timer_batch_stats_show(struct seq_file *m, void *v)
+{
+	int cpu, node;
+
+	seq_printf(m, "# enabled: %d  max_batch: %u  slack: %lu jiffies\n",
+		   static_key_enabled(&timer_batch_key), timer_batch_max,
+		   timer_batch_slack_mask + 1);
+	seq_printf(m, "# %-5s %12s %12s %10s  %s\n", "cpu", "runs",
+		   "offloaded", "max(us)", "softirq duration(us)");
+
+	for_each_possible_cpu(cpu) {
+		struct timer_batch_stats *st = per_cpu_ptr(&timer_batch_stats, cpu);
+
+		if (!st->runs && !st->offloaded)
+			continue;
+
+		seq_printf(m, "  %-5d %12lu %12lu %10llu ", cpu, st->runs,
+			   st->offloaded, div_u64(st->max_ns, NSEC_PER_USEC));
+		debug_stats_seq_hist(m, st->hist, TIMER_BATCH_HIST);
+		seq_putc(m, '\n');
+	}
+
+	seq_printf(m, "# %-5s %12s\n", "node", "expired");
+	for_each_online_node(node)
+		seq_printf(m, "  %-5d %12lu\n", node,
+			   timer_batch_nodes[node].expired);
+
+	return 0;
+}
+
+static int timer_batch_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, timer_batch_stats_show, NULL);
+}
+
+static const struct file_operations timer_batch_stats_fops = {
+	.open		= timer_batch_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* racy against concurrent updates, like callsite_table_reset() */
+static void timer_batch_reset(void)
+{
+	int cpu, node;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&timer_batch_stats, cpu), 0,
+		       sizeof(struct timer_batch_stats));
+	for_each_online_node(node)
+		timer_batch_nodes[node].expired = 0;
+}
+
+static struct debug_stats_ctl timer_batch_ctl = {
+	.key	= &timer_batch_key.key,
+	.lock	= &timer_batch_mutex,
+	.reset	= timer_batch_reset,
+};
+
+static int timer_batch_slack_get(void *data, u64 *val)
+{
+	*val = timer_batch_slack_mask + 1;
+	return 0;
+}
+
+/* the slack window is rounded up to a power of two number of jiffies */
+static int timer_batch_slack_set(void *data, u64 val)
+{
+	if (!val || val > HZ)
+		return -EINVAL;
+
+	timer_batch_slack_mask = roundup_pow_of_two(val) - 1;
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(timer_batch_slack_fops, timer_batch_slack_get,
+			timer_batch_slack_set, "%llu\n");
+
+static int __init timer_batch_setup(char *str)
+{
+	timer_batch_boot_enable = true;
+	return 1;
+}
+__setup("timer_batch", timer_batch_setup);
+
+static int __init timer_batch_init(void)
+{
+	struct dentry *dir;
+	int node;
+
+	timer_batch_nodes = kcalloc(nr_node_ids, sizeof(*timer_batch_nodes),
+				    GFP_KERNEL);
+	if (!timer_batch_nodes)
+		goto fail;
+
+	for_each_online_node(node) {
+		struct task_struct *t;
+
+		t = kthread_create_on_node(timer_batch_thread,
+					   &timer_batch_nodes[node], node,
+					   "ktimerbatch/%d", node);
+		if (IS_ERR(t))
+			goto fail;
+		timer_batch_nodes[node].task = t;
+		wake_up_process(t);
+	}
+
+	/* 4ms worth of slack by default */
+	timer_batch_slack_mask = roundup_pow_of_two(msecs_to_jiffies(4)) - 1;
+
+	dir = debugfs_create_dir("timer_batch", NULL);
+	if (dir) {
+		debug_stats_create_ctl(dir, &timer_batch_ctl);
+		debugfs_create_u32("max_batch", 0600, dir, &timer_batch_max);
+		debugfs_create_file("slack_jiffies", 0600, dir, NULL,
+				    &timer_batch_slack_fops);
+		debugfs_create_file("stats", 0400, dir, NULL,
+				    &timer_batch_stats_fops);
+	}
+
+	if (timer_batch_boot_enable)
+		static_branch_enable(&timer_batch_key);
+
+	return 0;
+
+fail:
+	pr_warn("timer_batch: could not start the expiry threads\n");
+	return -ENOMEM;
+}
+late_initcall(timer_batch_init);
+#endif /* CONFIG_TIMER_BATCH */
+
 static void process_timeout(unsigned long __data)
 {
 	wake_up_process((struct task_struct *)__data);
@@ -1793,6 +2206,9 @@ int timers_dead_cpu(unsigned int cpu)
 
 		for (i = 0; i < WHEEL_SIZE; i++)
 			migrate_timer_list(new_base, old_base->vectors + i);
+#ifdef CONFIG_TIMER_BATCH
+		migrate_timer_list(new_base, &old_base->overflow);
+#endif
 
 		spin_unlock(&old_base->lock);
 		spin_unlock_irq(&new_base->lock);
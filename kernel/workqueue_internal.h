@@ -52,6 +52,11 @@ struct worker {
 
 	/* used only by rescuers to point to the target workqueue */
 	struct workqueue_struct	*rescue_wq;	/* I: the workqueue to rescue */
+
+#ifdef CONFIG_WQ_STATS
+	u64			current_start;	/* L: current_work's start time */
+	u64			current_at;	/* L: runtime at current_start */
+#endif
 };
 
 /**
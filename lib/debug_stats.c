@@ -0,0 +1,265 @@
+/*
+ * Scaffolding shared by debugfs statistics, see <linux/debug_stats.h>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <linux/debug_stats.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/irqflags.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+static int debug_stats_enable_get(void *data, u64 *val)
+{
+	struct debug_stats_ctl *ctl = data;
+
+	*val = static_key_enabled(ctl->key);
+	return 0;
+}
+
+static int debug_stats_enable_set(void *data, u64 val)
+{
+	struct debug_stats_ctl *ctl = data;
+
+	mutex_lock(ctl->lock);
+	if (val && !static_key_enabled(ctl->key))
+		static_key_enable(ctl->key);
+	else if (!val && static_key_enabled(ctl->key))
+		static_key_disable(ctl->key);
+	mutex_unlock(ctl->lock);
+
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(debug_stats_enable_fops, debug_stats_enable_get,
+			debug_stats_enable_set, "%llu\n");
+
+static ssize_t debug_stats_reset_write(struct file *file,
+				       const char __user *buf,
+				       size_t count, loff_t *ppos)
+{
+	struct debug_stats_ctl *ctl = file_inode(file)->i_private;
+
+	mutex_lock(ctl->lock);
+	ctl->reset();
+	mutex_unlock(ctl->lock);
+
+	return count;
+}
+
+static const struct file_operations debug_stats_reset_fops = {
+	.open		= simple_open,
+	.write		= debug_stats_reset_write,
+	.llseek		= noop_llseek,
+};
+
+void debug_stats_create_ctl(struct dentry *dir, struct debug_stats_ctl *ctl)
+{
+	if (ctl->key)
+		debugfs_create_file("enable", 0600, dir, ctl,
+				    &debug_stats_enable_fops);
+	if (ctl->reset)
+		debugfs_create_file("reset", 0200, dir, ctl,
+				    &debug_stats_reset_fops);
+}
+
+/* Print the non-empty buckets of a debug_stats_log2_bucket() histogram. */
+void debug_stats_seq_hist(struct seq_file *m, const unsigned int *hist,
+			  unsigned int nr)
+{
+	unsigned int b;
+
+	for (b = 0; b < nr; b++) {
+		if (!hist[b])
+			continue;
+		if (!b)
+			seq_printf(m, " <1:%u", hist[b]);
+		else if (b == nr - 1)
+			seq_printf(m, " >=%lu:%u", 1UL << (b - 1), hist[b]);
+		else
+			seq_printf(m, " %lu:%u", 1UL << (b - 1), hist[b]);
+	}
+}
+
+#define CALLSITE_MAX_PROBE	8
+
+static inline unsigned int callsite_table_size(struct callsite_table *t)
+{
+	return 1U << t->hash_bits;
+}
+
+static inline struct callsite_entry *
+callsite_at(struct callsite_table *t, void *base, unsigned int i)
+{
+	return base + i * t->entry_size;
+}
+
+int callsite_table_init(struct callsite_table *t)
+{
+	size_t bytes = callsite_table_size(t) * t->entry_size;
+	int cpu;
+
+	t->tables = kcalloc(nr_cpu_ids, sizeof(*t->tables), GFP_KERNEL);
+	t->dropped = alloc_percpu(unsigned long);
+	if (!t->tables || !t->dropped)
+		goto fail;
+
+	for_each_possible_cpu(cpu) {
+		t->tables[cpu] = vzalloc_node(bytes, cpu_to_node(cpu));
+		if (!t->tables[cpu])
+			goto fail;
+	}
+
+	return 0;
+
+fail:
+	callsite_table_destroy(t);
+	return -ENOMEM;
+}
+
+void callsite_table_destroy(struct callsite_table *t)
+{
+	int cpu;
+
+	if (t->tables) {
+		for_each_possible_cpu(cpu)
+			vfree(t->tables[cpu]);
+		kfree(t->tables);
+		t->tables = NULL;
+	}
+	free_percpu(t->dropped);
+	t->dropped = NULL;
+}
+
+/*
+ * Find or claim the entry of @ip and @tag in the local cpu's table, or
+ * return NULL, counting the update as dropped, if its probe sequence is
+ * full.  The caller must have irqs disabled.
+ */
+struct callsite_entry *
+callsite_table_lookup(struct callsite_table *t, unsigned long ip,
+		      unsigned int tag)
+{
+	unsigned int i, h, mask = callsite_table_size(t) - 1;
+	struct callsite_entry *e;
+	void *table;
+
+	if (!t->tables)
+		return NULL;
+
+	table = t->tables[smp_processor_id()];
+	h = hash_long(ip ^ tag, t->hash_bits);
+	for (i = 0; i < CALLSITE_MAX_PROBE; i++) {
+		e = callsite_at(t, table, (h + i) & mask);
+		if (e->ip == ip && e->tag == tag)
+			return e;
+		if (!e->ip) {
+			e->tag = tag;
+			WRITE_ONCE(e->ip, ip);
+			return e;
+		}
+	}
+	__this_cpu_inc(*t->dropped);
+
+	return NULL;
+}
+
+/*
+ * Room for twice a per-cpu table, so that the merge can't overflow unless
+ * the per-cpu tables hold different call sites.
+ */
+void *callsite_table_alloc_merged(struct callsite_table *t)
+{
+	return vzalloc(2 * callsite_table_size(t) * t->entry_size);
+}
+
+static int callsite_cmp(const void *a, const void *b)
+{
+	const struct callsite_entry *ea = a, *eb = b;
+
+	if (ea->total_ns == eb->total_ns)
+		return 0;
+	return ea->total_ns > eb->total_ns ? -1 : 1;
+}
+
+/*
+ * Merge the per-cpu tables into @merged, from callsite_table_alloc_merged(),
+ * and sort it by total time, largest first.  Returns the number of entries
+ * used; @dropped gets the updates that found no room.
+ */
+int callsite_table_merge(struct callsite_table *t, void *merged,
+			 unsigned long *dropped)
+{
+	int cpu, nr = 0, size = 2 * callsite_table_size(t);
+
+	*dropped = 0;
+	for_each_possible_cpu(cpu) {
+		void *table = t->tables[cpu];
+		int i, j;
+
+		*dropped += per_cpu(*t->dropped, cpu);
+
+		for (i = 0; i < callsite_table_size(t); i++) {
+			struct callsite_entry *src = callsite_at(t, table, i);
+			struct callsite_entry *dst = NULL;
+			unsigned long ip = READ_ONCE(src->ip);
+
+			if (!ip)
+				continue;
+
+			for (j = 0; j < nr; j++) {
+				struct callsite_entry *e = callsite_at(t, merged, j);
+
+				if (e->ip == ip && e->tag == src->tag) {
+					dst = e;
+					break;
+				}
+			}
+			if (!dst) {
+				if (nr == size) {
+					(*dropped)++;
+					continue;
+				}
+				dst = callsite_at(t, merged, nr++);
+				dst->ip = ip;
+				dst->tag = src->tag;
+			}
+
+			dst->count += src->count;
+			dst->total_ns += src->total_ns;
+			dst->max_ns = max(dst->max_ns, src->max_ns);
+			if (t->merge)
+				t->merge(dst, src);
+		}
+	}
+
+	sort(merged, nr, t->entry_size, callsite_cmp, NULL);
+
+	return nr;
+}
+
+void callsite_table_reset(struct callsite_table *t)
+{
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		/*
+		 * Updates run with irqs off on their own cpu; this only
+		 * excludes the local one, so a concurrent update elsewhere
+		 * may leave a stray count behind. Good enough for statistics.
+		 */
+		local_irq_save(flags);
+		memset(t->tables[cpu], 0,
+		       callsite_table_size(t) * t->entry_size);
+		per_cpu(*t->dropped, cpu) = 0;
+		local_irq_restore(flags);
+	}
+}
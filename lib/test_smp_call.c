@@ -0,0 +1,177 @@
+/*
+ * Cross-CPU function call test and benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * For 1, 2, 4, ... target CPUs, compares smp_call_function_many() going
+ * through one csd per target with the shared broadcast descriptor of
+ * smp_call_function_broadcast():
+ *
+ *   lat(ns)	average round trip of a synchronous call
+ *   calls/s	back to back asynchronous calls
+ *
+ * and checks that every call ran exactly once on every target.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/atomic.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/smp.h>
+
+static unsigned int iterations = 1000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "calls per CPU count and mode (default 1000)");
+
+/* calls issued with preemption disabled before giving the CPU up */
+#define TEST_BATCH	64
+
+static atomic_t hits;
+
+static void test_smp_call_func(void *info)
+{
+	atomic_inc(&hits);
+}
+
+typedef void (*test_call_t)(const struct cpumask *mask, smp_call_func_t func,
+			    void *info, bool wait);
+
+/* the first @nr online CPUs other than this one */
+static void test_smp_call_mask(struct cpumask *mask, unsigned int nr)
+{
+	int cpu, this_cpu = smp_processor_id();
+
+	cpumask_clear(mask);
+	for_each_online_cpu(cpu) {
+		if (cpu == this_cpu)
+			continue;
+		if (cpumask_weight(mask) == nr)
+			break;
+		cpumask_set_cpu(cpu, mask);
+	}
+}
+
+/*
+ * Issue @iterations calls to @nr CPUs and return the elapsed time in ns,
+ * or 0 if some target missed a call.
+ */
+static u64 test_smp_call_run(test_call_t call, struct cpumask *mask,
+			     unsigned int nr, bool wait)
+{
+	unsigned int i, j, expected = 0;
+	u64 start, end;
+
+	atomic_set(&hits, 0);
+	start = ktime_get_ns();
+	for (i = 0; i < iterations; i += TEST_BATCH) {
+		preempt_disable();
+		test_smp_call_mask(mask, nr);
+		for (j = i; j < min(i + TEST_BATCH, iterations); j++) {
+			call(mask, test_smp_call_func, NULL, wait);
+			expected += nr;
+			if (wait && atomic_read(&hits) != expected) {
+				preempt_enable();
+				return 0;
+			}
+		}
+		/* flush outstanding asynchronous calls */
+		if (!wait) {
+			call(mask, test_smp_call_func, NULL, true);
+			expected += nr;
+		}
+		preempt_enable();
+		cond_resched();
+	}
+	end = ktime_get_ns();
+
+	if (atomic_read(&hits) != expected)
+		return 0;
+
+	return max_t(u64, end - start, 1);
+}
+
+static int test_smp_call_nr(struct cpumask *mask, unsigned int nr)
+{
+	static const struct {
+		const char	*name;
+		test_call_t	call;
+	} modes[] = {
+		{ "csd",	smp_call_function_many },
+		{ "bcast",	smp_call_function_broadcast },
+	};
+	u64 lat[ARRAY_SIZE(modes)], tput[ARRAY_SIZE(modes)];
+	int m;
+
+	for (m = 0; m < ARRAY_SIZE(modes); m++) {
+		u64 sync, async;
+
+		sync = test_smp_call_run(modes[m].call, mask, nr, true);
+		async = test_smp_call_run(modes[m].call, mask, nr, false);
+		if (!sync || !async) {
+			pr_err("%s: %u cpus: lost calls\n", modes[m].name, nr);
+			return -EINVAL;
+		}
+		lat[m] = div_u64(sync, iterations);
+		tput[m] = div64_u64((u64)iterations * NSEC_PER_SEC, async);
+	}
+
+	pr_info("%5u %14llu %14llu %14llu %14llu\n", nr,
+		lat[0], lat[1], tput[0], tput[1]);
+
+	return 0;
+}
+
+static int __init test_smp_call_init(void)
+{
+	unsigned int nr, max_nr;
+	cpumask_var_t mask;
+	int ret = 0;
+
+	if (!iterations)
+		return -EINVAL;
+
+	get_online_cpus();
+	max_nr = num_online_cpus() - 1;
+	if (!max_nr) {
+		pr_info("need at least 2 online cpus, skipping\n");
+		goto out_put;
+	}
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL)) {
+		ret = -ENOMEM;
+		goto out_put;
+	}
+
+	pr_info("%5s %14s %14s %14s %14s\n", "cpus", "csd lat(ns)",
+		"bcast lat(ns)", "csd calls/s", "bcast calls/s");
+
+	for (nr = 1; ; nr = min(nr * 2, max_nr)) {
+		ret = test_smp_call_nr(mask, nr);
+		if (ret || nr == max_nr)
+			break;
+	}
+
+	free_cpumask_var(mask);
+	if (!ret)
+		pr_info("test passed\n");
+out_put:
+	put_online_cpus();
+	return ret;
+}
+
+static void __exit test_smp_call_exit(void)
+{
+}
+
+module_init(test_smp_call_init);
+module_exit(test_smp_call_exit);
+
+MODULE_DESCRIPTION("cross-CPU function call test");
+MODULE_LICENSE("GPL");
@@ -1826,7 +1826,8 @@ static void reclaim_high(struct mem_cgroup *memcg,
 		if (page_counter_read(&memcg->memory) <= memcg->high)
 			continue;
 		mem_cgroup_event(memcg, MEMCG_HIGH);
-		try_to_free_mem_cgroup_pages(memcg, nr_pages, gfp_mask, true);
+		try_to_free_mem_cgroup_pages(memcg, nr_pages, gfp_mask,
+					     MEMCG_RECLAIM_MAY_SWAP);
 	} while ((memcg = parent_mem_cgroup(memcg)));
 }
 
@@ -1864,7 +1865,7 @@ static int try_charge(struct mem_cgroup *memcg, gfp_t gfp_mask,
 	struct mem_cgroup *mem_over_limit;
 	struct page_counter *counter;
 	unsigned long nr_reclaimed;
-	bool may_swap = true;
+	unsigned int reclaim_options = MEMCG_RECLAIM_MAY_SWAP;
 	bool drained = false;
 
 	if (mem_cgroup_is_root(memcg))
@@ -1882,7 +1883,7 @@ retry:
 		mem_over_limit = mem_cgroup_from_counter(counter, memory);
 	} else {
 		mem_over_limit = mem_cgroup_from_counter(counter, memsw);
-		may_swap = false;
+		reclaim_options &= ~MEMCG_RECLAIM_MAY_SWAP;
 	}
 
 	if (batch > nr_pages) {
@@ -1919,7 +1920,7 @@ retry:
 	mem_cgroup_event(mem_over_limit, MEMCG_MAX);
 
 	nr_reclaimed = try_to_free_mem_cgroup_pages(mem_over_limit, nr_pages,
-						    gfp_mask, may_swap);
+						    gfp_mask, reclaim_options);
 
 	if (mem_cgroup_margin(mem_over_limit) >= nr_pages)
 		goto retry;
@@ -2460,7 +2461,8 @@ static int mem_cgroup_resize_limit(struct mem_cgroup *memcg,
 		if (!ret)
 			break;
 
-		try_to_free_mem_cgroup_pages(memcg, 1, GFP_KERNEL, true);
+		try_to_free_mem_cgroup_pages(memcg, 1, GFP_KERNEL,
+					     MEMCG_RECLAIM_MAY_SWAP);
 
 		curusage = page_counter_read(&memcg->memory);
 		/* Usage is reduced ? */
@@ -2511,7 +2513,7 @@ static int mem_cgroup_resize_memsw_limit(struct mem_cgroup *memcg,
 		if (!ret)
 			break;
 
-		try_to_free_mem_cgroup_pages(memcg, 1, GFP_KERNEL, false);
+		try_to_free_mem_cgroup_pages(memcg, 1, GFP_KERNEL, 0);
 
 		curusage = page_counter_read(&memcg->memsw);
 		/* Usage is reduced ? */
@@ -2644,8 +2646,8 @@ static int mem_cgroup_force_empty(struct mem_cgroup *memcg)
 		if (signal_pending(current))
 			return -EINTR;
 
-		progress = try_to_free_mem_cgroup_pages(memcg, 1,
-							GFP_KERNEL, true);
+		progress = try_to_free_mem_cgroup_pages(memcg, 1, GFP_KERNEL,
+							MEMCG_RECLAIM_MAY_SWAP);
 		if (!progress) {
 			nr_retries--;
 			/* maybe some writeback is necessary */
@@ -3412,13 +3414,20 @@ static int __mem_cgroup_usage_register_event(struct mem_cgroup *memcg,
 	}
 
 	/* Free old spare buffer and save old primary buffer as spare */
+	if (thresholds->spare &&
+	    !poll_state_synchronize_rcu(thresholds->spare_gp))
+		synchronize_rcu();
 	kfree(thresholds->spare);
 	thresholds->spare = thresholds->primary;
 
 	rcu_assign_pointer(thresholds->primary, new);
 
-	/* To be sure that nobody uses thresholds */
-	synchronize_rcu();
+	/*
+	 * Nothing is freed here, so there is no need to wait for readers
+	 * of the old primary array; just remember when the grace period
+	 * that makes it safe to reuse as the spare started.
+	 */
+	thresholds->spare_gp = start_poll_synchronize_rcu();
 
 unlock:
 	mutex_unlock(&memcg->thresholds_lock);
@@ -3472,6 +3481,10 @@ static void __mem_cgroup_usage_unregister_event(struct mem_cgroup *memcg,
 
 	new = thresholds->spare;
 
+	/* Readers may still be using the spare if it was just swapped out */
+	if (new && !poll_state_synchronize_rcu(thresholds->spare_gp))
+		synchronize_rcu();
+
 	/* Set thresholds array to NULL if we don't have thresholds */
 	if (!size) {
 		kfree(new);
@@ -3505,7 +3518,8 @@ swap_buffers:
 
 	rcu_assign_pointer(thresholds->primary, new);
 
-	/* To be sure that nobody uses thresholds */
+	/* To be sure that nobody uses thresholds or the removed eventfd */
+	thresholds->spare_gp = get_state_synchronize_rcu();
 	synchronize_rcu();
 
 	/* If all events are unregistered, free the spare array */
@@ -5089,7 +5103,7 @@ static ssize_t memory_high_write(struct kernfs_open_file *of,
 	nr_pages = page_counter_read(&memcg->memory);
 	if (nr_pages > high)
 		try_to_free_mem_cgroup_pages(memcg, nr_pages - high,
-					     GFP_KERNEL, true);
+					     GFP_KERNEL, MEMCG_RECLAIM_MAY_SWAP);
 
 	memcg_wb_domain_size_changed(memcg);
 	return nbytes;
@@ -5143,7 +5157,7 @@ static ssize_t memory_max_write(struct kernfs_open_file *of,
 
 		if (nr_reclaims) {
 			if (!try_to_free_mem_cgroup_pages(memcg, nr_pages - max,
-							  GFP_KERNEL, true))
+						GFP_KERNEL, MEMCG_RECLAIM_MAY_SWAP))
 				nr_reclaims--;
 			continue;
 		}
@@ -5157,6 +5171,87 @@ static ssize_t memory_max_write(struct kernfs_open_file *of,
 	return nbytes;
 }
 
+static int memory_reclaim_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(seq_css(m));
+
+	seq_printf(m, "%llu\n", (u64)READ_ONCE(memcg->reclaim_last) * PAGE_SIZE);
+	return 0;
+}
+
+/*
+ * Proactive reclaim: "<bytes> [anon|file]" asks for that much memory to
+ * be reclaimed from the subtree without touching its limits.  The write
+ * fails with -EAGAIN if the full amount could not be reclaimed; reading
+ * the file reports how much the last request actually got back.
+ */
+static ssize_t memory_reclaim_write(struct kernfs_open_file *of,
+				    char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned int nr_retries = MEM_CGROUP_RECLAIM_RETRIES;
+	unsigned int reclaim_options = MEMCG_RECLAIM_MAY_SWAP;
+	unsigned long nr_to_reclaim, nr_reclaimed = 0;
+	char *bias, *end;
+	int err = 0;
+
+	buf = strstrip(buf);
+	bias = strpbrk(buf, " \t");
+	if (bias) {
+		*bias++ = '\0';
+		bias = skip_spaces(bias);
+		if (!strcmp(bias, "anon"))
+			reclaim_options |= MEMCG_RECLAIM_ANON_ONLY;
+		else if (!strcmp(bias, "file"))
+			reclaim_options &= ~MEMCG_RECLAIM_MAY_SWAP;
+		else
+			return -EINVAL;
+	}
+
+	nr_to_reclaim = DIV_ROUND_UP(memparse(buf, &end), PAGE_SIZE);
+	if (end == buf || *end != '\0')
+		return -EINVAL;
+
+	/* Anon-only reclaim cannot make any progress without swap. */
+	if ((reclaim_options & MEMCG_RECLAIM_ANON_ONLY) &&
+	    mem_cgroup_get_nr_swap_pages(memcg) <= 0)
+		return -EAGAIN;
+
+	while (nr_reclaimed < nr_to_reclaim) {
+		unsigned long reclaimed;
+
+		if (signal_pending(current)) {
+			err = -EINTR;
+			break;
+		}
+
+		/*
+		 * Ask for the remainder in SWAP_CLUSTER_MAX sized chunks
+		 * at most, so that a huge request does not overshoot by
+		 * a whole reclaim cycle and stays responsive to signals.
+		 */
+		reclaimed = try_to_free_mem_cgroup_pages(memcg,
+				min(nr_to_reclaim - nr_reclaimed,
+				    (unsigned long)SWAP_CLUSTER_MAX),
+				GFP_KERNEL, reclaim_options);
+
+		if (!reclaimed) {
+			if (!nr_retries--) {
+				err = -EAGAIN;
+				break;
+			}
+		} else {
+			nr_retries = MEM_CGROUP_RECLAIM_RETRIES;
+		}
+
+		nr_reclaimed += reclaimed;
+	}
+
+	WRITE_ONCE(memcg->reclaim_last, nr_reclaimed);
+
+	return err ? err : nbytes;
+}
+
 static int memory_events_show(struct seq_file *m, void *v)
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_css(seq_css(m));
@@ -5241,6 +5336,45 @@ static int memory_stat_show(struct seq_file *m, void *v)
 	return 0;
 }
 
+#ifdef CONFIG_IDLE_PAGE_TRACKING
+static int memory_idle_page_stats_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(seq_css(m));
+	struct idle_page_stats stats = { };
+	struct mem_cgroup *mi;
+	int file, i;
+
+	/*
+	 * Bytes of memory that stayed idle for at least the given number
+	 * of scans, as of the last full scan of kidled.  Each bucket
+	 * excludes the older ones.
+	 */
+	for_each_mem_cgroup_tree(mi, memcg)
+		for (file = 0; file < 2; file++)
+			for (i = 0; i < KIDLED_NR_BUCKETS; i++)
+				stats.nr_pages[file][i] +=
+					READ_ONCE(mi->idle_stats.nr_pages[file][i]);
+
+	seq_printf(m, "scan_period_secs %u\n", READ_ONCE(kidled_scan_period));
+	seq_printf(m, "full_scans %lu\n", READ_ONCE(kidled_full_scans));
+
+	seq_puts(m, "buckets");
+	for (i = 0; i < KIDLED_NR_BUCKETS; i++)
+		seq_printf(m, " %u", kidled_bucket_age[i]);
+	seq_putc(m, '\n');
+
+	for (file = 0; file < 2; file++) {
+		seq_puts(m, file ? "file" : "anon");
+		for (i = 0; i < KIDLED_NR_BUCKETS; i++)
+			seq_printf(m, " %llu",
+				   (u64)stats.nr_pages[file][i] * PAGE_SIZE);
+		seq_putc(m, '\n');
+	}
+
+	return 0;
+}
+#endif
+
 static struct cftype memory_files[] = {
 	{
 		.name = "current",
@@ -5265,6 +5399,12 @@ static struct cftype memory_files[] = {
 		.seq_show = memory_max_show,
 		.write = memory_max_write,
 	},
+	{
+		.name = "reclaim",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_reclaim_show,
+		.write = memory_reclaim_write,
+	},
 	{
 		.name = "events",
 		.flags = CFTYPE_NOT_ON_ROOT,
@@ -5276,6 +5416,12 @@ static struct cftype memory_files[] = {
 		.flags = CFTYPE_NOT_ON_ROOT,
 		.seq_show = memory_stat_show,
 	},
+#ifdef CONFIG_IDLE_PAGE_TRACKING
+	{
+		.name = "idle_page_stats",
+		.seq_show = memory_idle_page_stats_show,
+	},
+#endif
 	{ }	/* terminate */
 };
 
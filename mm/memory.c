@@ -3906,6 +3906,221 @@ int handle_mm_fault(struct vm_area_struct *vma, unsigned long address,
 }
 EXPORT_SYMBOL_GPL(handle_mm_fault);
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Look up the vma covering @addr without mmap_sem.  vmas are freed after
+ * an RCU grace period and the rbtree is rotated with WRITE_ONCE(), so the
+ * walk is safe but may miss or return a vma that is being changed: the
+ * caller has to validate the result against vm_sequence.
+ */
+static struct vm_area_struct *find_vma_rcu(struct mm_struct *mm,
+					   unsigned long addr)
+{
+	struct rb_node *rb_node = READ_ONCE(mm->mm_rb.rb_node);
+
+	while (rb_node) {
+		struct vm_area_struct *vma;
+
+		vma = rb_entry(rb_node, struct vm_area_struct, vm_rb);
+		if (addr >= READ_ONCE(vma->vm_end))
+			rb_node = READ_ONCE(rb_node->rb_right);
+		else if (addr < READ_ONCE(vma->vm_start))
+			rb_node = READ_ONCE(rb_node->rb_left);
+		else
+			return vma;
+	}
+	return NULL;
+}
+
+/*
+ * Walk down to the pmd with interrupts disabled, like gup_fast: page
+ * tables are only freed after a TLB shootdown IPI, which cannot be
+ * delivered to us while we are in here.  Returns NULL unless a regular
+ * page table is installed at @address.
+ */
+static pmd_t *spf_find_pmd(struct mm_struct *mm, unsigned long address,
+			   pmd_t *pmdvalp)
+{
+	pgd_t *pgd;
+	p4d_t *p4d;
+	pud_t *pud;
+	pmd_t *pmd, pmdval;
+
+	pgd = pgd_offset(mm, address);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		return NULL;
+	p4d = p4d_offset(pgd, address);
+	if (p4d_none(*p4d) || unlikely(p4d_bad(*p4d)))
+		return NULL;
+	pud = pud_offset(p4d, address);
+	if (pud_none(*pud) || unlikely(pud_bad(*pud)))
+		return NULL;
+	pmd = pmd_offset(pud, address);
+	pmdval = READ_ONCE(*pmd);
+	if (pmd_none(pmdval) || pmd_trans_huge(pmdval) ||
+	    pmd_devmap(pmdval) || unlikely(pmd_bad(pmdval)))
+		return NULL;
+
+	*pmdvalp = pmdval;
+	return pmd;
+}
+
+/*
+ * Try to resolve a not-present fault on anonymous memory without taking
+ * mmap_sem.  Only the common first-touch case is handled: a private
+ * anonymous vma that already has an anon_vma, a page table and an empty
+ * pte.  Nothing here sleeps; whenever that is not enough, or the vma
+ * changed under us, VM_FAULT_RETRY tells the caller to take mmap_sem and
+ * go through handle_mm_fault() instead.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags)
+{
+	struct mem_cgroup *memcg = NULL;
+	struct vm_area_struct *vma;
+	struct page *page = NULL;
+	unsigned long vm_flags;
+	pgprot_t vm_page_prot;
+	pmd_t *pmd, pmdval;
+	pte_t *pte, entry;
+	spinlock_t *ptl;
+	unsigned int seq;
+	unsigned long irqflags;
+	bool write = flags & FAULT_FLAG_WRITE;
+
+	rcu_read_lock();
+
+	vma = find_vma_rcu(mm, address);
+	if (!vma || vma->vm_mm != mm)
+		goto out_rcu;
+
+	seq = raw_read_seqcount(&vma->vm_sequence);
+	if (seq & 1)
+		goto out_rcu;
+	smp_rmb();
+
+	vm_flags = READ_ONCE(vma->vm_flags);
+	vm_page_prot = READ_ONCE(vma->vm_page_prot);
+	if (address < READ_ONCE(vma->vm_start) ||
+	    address >= READ_ONCE(vma->vm_end))
+		goto out_rcu;
+
+	/* Faults this path never handles are not validation failures */
+	if (!vma_is_anonymous(vma) || !READ_ONCE(vma->anon_vma) ||
+	    vma_policy(vma) || userfaultfd_armed(vma))
+		goto out_unsupported;
+	if (vm_flags & (VM_SHARED | VM_GROWSDOWN | VM_GROWSUP |
+			VM_HUGETLB | VM_PFNMAP | VM_MIXEDMAP))
+		goto out_unsupported;
+	if (write ? !(vm_flags & VM_WRITE) :
+		    !(vm_flags & (VM_READ | VM_EXEC | VM_WRITE)))
+		goto out_unsupported;
+	if (!arch_vma_access_permitted(vma, write,
+				       flags & FAULT_FLAG_INSTRUCTION,
+				       flags & FAULT_FLAG_REMOTE))
+		goto out_unsupported;
+	if (unlikely(test_bit(MMF_UNSTABLE, &mm->flags)))
+		goto out_rcu;
+
+	/* Cheap check that there is a page table with an empty pte */
+	local_irq_save(irqflags);
+	pmd = spf_find_pmd(mm, address, &pmdval);
+	if (pmd) {
+		pte = pte_offset_map(&pmdval, address);
+		entry = READ_ONCE(*pte);
+		pte_unmap(pte);
+	}
+	local_irq_restore(irqflags);
+	if (!pmd || !pte_none(entry))
+		goto out_rcu;
+
+	if (write) {
+		page = alloc_page((GFP_HIGHUSER_MOVABLE & ~__GFP_DIRECT_RECLAIM) |
+				  __GFP_ZERO | __GFP_NOWARN);
+		if (!page)
+			goto out_rcu;
+		if (mem_cgroup_try_charge(page, mm, GFP_NOWAIT, &memcg, false))
+			goto out_put;
+		__SetPageUptodate(page);
+
+		entry = mk_pte(page, vm_page_prot);
+		if (vm_flags & VM_WRITE)
+			entry = pte_mkwrite(pte_mkdirty(entry));
+	} else {
+		if (mm_forbids_zeropage(mm))
+			goto out_rcu;
+		entry = pte_mkspecial(pfn_pte(my_zero_pfn(address),
+					      vm_page_prot));
+	}
+
+	/*
+	 * Somebody holding the page table lock may be waiting for us to
+	 * ack a TLB flush, so only trylock it with interrupts off.  Once
+	 * the lock is held and the pmd is still the one we walked, the
+	 * page table cannot be freed under us anymore.
+	 */
+	local_irq_save(irqflags);
+	pmd = spf_find_pmd(mm, address, &pmdval);
+	if (!pmd) {
+		local_irq_restore(irqflags);
+		goto out_uncharge;
+	}
+	ptl = pte_lockptr(mm, &pmdval);
+	if (!spin_trylock(ptl)) {
+		local_irq_restore(irqflags);
+		goto out_uncharge;
+	}
+	if (!pmd_same(*pmd, pmdval)) {
+		spin_unlock(ptl);
+		local_irq_restore(irqflags);
+		goto out_uncharge;
+	}
+	local_irq_restore(irqflags);
+
+	pte = pte_offset_map(pmd, address);
+	if (!pte_none(*pte) ||
+	    read_seqcount_retry(&vma->vm_sequence, seq)) {
+		pte_unmap_unlock(pte, ptl);
+		goto out_uncharge;
+	}
+
+	if (page) {
+		inc_mm_counter_fast(mm, MM_ANONPAGES);
+		page_add_new_anon_rmap(page, vma, address, false);
+		mem_cgroup_commit_charge(page, memcg, false, false);
+		lru_cache_add_active_or_unevictable(page, vma);
+	}
+	set_pte_at(mm, address, pte, entry);
+
+	/* No need to invalidate - it was non-present before */
+	update_mmu_cache(vma, address, pte);
+	pte_unmap_unlock(pte, ptl);
+	rcu_read_unlock();
+
+	__set_current_state(TASK_RUNNING);
+	count_vm_event(PGFAULT);
+	mem_cgroup_count_vm_event(mm, PGFAULT);
+	count_vm_event(SPECULATIVE_PGFAULT);
+	return 0;
+
+out_uncharge:
+	if (memcg)
+		mem_cgroup_cancel_charge(page, memcg, false);
+out_put:
+	if (page)
+		put_page(page);
+out_rcu:
+	rcu_read_unlock();
+	count_vm_event(SPECULATIVE_PGFAULT_ABORT);
+	return VM_FAULT_RETRY;
+
+out_unsupported:
+	rcu_read_unlock();
+	count_vm_event(SPECULATIVE_PGFAULT_UNSUPPORTED);
+	return VM_FAULT_RETRY;
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 #ifndef __PAGETABLE_P4D_FOLDED
 /*
  * Allocate p4d page table.
@@ -1893,6 +1893,146 @@ out:
 	put_page(page);
 	return 0;
 }
+
+/*
+ * Accessed-bit sampling for NUMA balancing.
+ *
+ * Instead of making ptes PROT_NONE and waiting for hinting faults, every
+ * scan pass clears the young bit of the ptes in the window and marks the
+ * pages idle, reusing the idle page tracking flags.  A page whose pte is
+ * found young again while it is still marked idle has been touched since
+ * the previous pass and counts as hot.  Hot private pages that live on a
+ * node other than the target are isolated and migrated as one batch.
+ *
+ * The idle and young flags are global page state, not private to this
+ * scanner.  Userspace idle page tracking and kidled clear and test the
+ * same bits, so running either of them alongside sampling mode makes
+ * both report garbage: the mode is for systems that use neither.
+ */
+#define NUMA_SAMPLE_BATCH	512
+
+struct numa_sample_control {
+	struct list_head pages;
+	int target_nid;
+	unsigned long nr_sampled;
+	unsigned long nr_isolated;
+};
+
+static int numa_sample_pmd_range(pmd_t *pmd, unsigned long addr,
+				 unsigned long end, struct mm_walk *walk)
+{
+	struct numa_sample_control *nsc = walk->private;
+	struct vm_area_struct *vma = walk->vma;
+	pg_data_t *pgdat = NODE_DATA(nsc->target_nid);
+	pte_t *orig_pte, *pte;
+	spinlock_t *ptl;
+
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(walk->mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		struct page *page;
+		bool hot;
+
+		if (!pte_present(*pte))
+			continue;
+
+		page = vm_normal_page(vma, addr, *pte);
+		if (!page || PageKsm(page) || !PageLRU(page))
+			continue;
+
+		/* PTE-mapped THP: leave it to the hinting fault path */
+		if (PageCompound(page))
+			continue;
+
+		nsc->nr_sampled++;
+		hot = false;
+		if (ptep_clear_young_notify(vma, addr, pte)) {
+			/* Keep page_referenced() honest for reclaim */
+			set_page_young(page);
+			hot = page_is_idle(page);
+		}
+		set_page_idle(page);
+
+		if (!hot || page_to_nid(page) == nsc->target_nid)
+			continue;
+
+		/* Shared pages are left to the hinting fault path */
+		if (page_mapcount(page) != 1 ||
+		    nsc->nr_isolated >= NUMA_SAMPLE_BATCH)
+			continue;
+
+		if (numamigrate_update_ratelimit(pgdat, 1))
+			continue;
+
+		get_page(page);
+		if (!numamigrate_isolate_page(pgdat, page)) {
+			put_page(page);
+			continue;
+		}
+
+		list_add_tail(&page->lru, &nsc->pages);
+		nsc->nr_isolated++;
+	}
+	pte_unmap_unlock(orig_pte, ptl);
+	cond_resched();
+
+	return 0;
+}
+
+/**
+ * numa_migrate_hot_pages - sample a range and migrate its hot remote pages
+ * @vma: the vma containing the range, mmap_sem held for read
+ * @start: start of the range
+ * @end: end of the range
+ * @target_nid: node the hot pages should be moved to
+ * @nr_migrated: incremented by the number of pages migrated
+ *
+ * Returns the number of present pages that were sampled.
+ */
+unsigned long numa_migrate_hot_pages(struct vm_area_struct *vma,
+				     unsigned long start, unsigned long end,
+				     int target_nid, unsigned long *nr_migrated)
+{
+	struct numa_sample_control nsc = {
+		.pages = LIST_HEAD_INIT(nsc.pages),
+		.target_nid = target_nid,
+	};
+	struct mm_walk walk = {
+		.pmd_entry = numa_sample_pmd_range,
+		.mm = vma->vm_mm,
+		.private = &nsc,
+	};
+	unsigned long nr_succeeded = 0;
+	int nr_remaining;
+
+	if (!IS_ENABLED(CONFIG_IDLE_PAGE_TRACKING))
+		return 0;
+
+	walk_page_range(start, end, &walk);
+
+	if (list_empty(&nsc.pages))
+		return nsc.nr_sampled;
+
+	/*
+	 * migrate_pages() drops permanently failed pages from the list on
+	 * its own, so what is left there is not a failure count.  Its
+	 * return value is; on an error nothing can be claimed as migrated.
+	 */
+	nr_remaining = migrate_pages(&nsc.pages, alloc_misplaced_dst_page,
+				     NULL, target_nid, MIGRATE_ASYNC,
+				     MR_NUMA_MISPLACED);
+	if (nr_remaining >= 0)
+		nr_succeeded = nsc.nr_isolated - nr_remaining;
+	if (nr_remaining)
+		putback_movable_pages(&nsc.pages);
+
+	count_vm_numa_events(NUMA_PAGE_MIGRATE, nr_succeeded);
+	*nr_migrated += nr_succeeded;
+
+	return nsc.nr_sampled;
+}
 #endif /* CONFIG_NUMA_BALANCING */
 
 #if defined(CONFIG_NUMA_BALANCING) && defined(CONFIG_TRANSPARENT_HUGEPAGE)
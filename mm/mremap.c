@@ -265,7 +265,7 @@ static unsigned long move_vma(struct vm_area_struct *vma,
 		struct list_head *uf_unmap)
 {
 	struct mm_struct *mm = vma->vm_mm;
-	struct vm_area_struct *new_vma;
+	struct vm_area_struct *old_vma, *new_vma;
 	unsigned long vm_flags = vma->vm_flags;
 	unsigned long new_pgoff;
 	unsigned long moved_len;
@@ -300,6 +300,15 @@ static unsigned long move_vma(struct vm_area_struct *vma,
 	if (!new_vma)
 		return -ENOMEM;
 
+	/*
+	 * Keep speculative faults out of both ranges while the ptes move,
+	 * or one could install a pte that move_ptes() then overwrites.
+	 */
+	old_vma = vma;
+	vm_write_begin(old_vma);
+	if (new_vma != old_vma)
+		vm_write_begin(new_vma);
+
 	moved_len = move_page_tables(vma, old_addr, new_vma, new_addr, old_len,
 				     need_rmap_locks);
 	if (moved_len < old_len) {
@@ -326,6 +335,10 @@ static unsigned long move_vma(struct vm_area_struct *vma,
 			   new_addr, new_addr + new_len);
 	}
 
+	if (new_vma != old_vma)
+		vm_write_end(new_vma);
+	vm_write_end(old_vma);
+
 	/* Conceal VM_ACCOUNT so old reservation is not undone */
 	if (vm_flags & VM_ACCOUNT) {
 		vma->vm_flags &= ~VM_ACCOUNT;
@@ -10,6 +10,12 @@
 #include <linux/mmu_notifier.h>
 #include <linux/page_ext.h>
 #include <linux/page_idle.h>
+#include <linux/memcontrol.h>
+#include <linux/mm_inline.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/vmalloc.h>
+#include <linux/math64.h>
 
 #define BITMAP_CHUNK_SIZE	sizeof(u64)
 #define BITMAP_CHUNK_BITS	(BITMAP_CHUNK_SIZE * BITS_PER_BYTE)
@@ -195,6 +201,212 @@ static ssize_t page_idle_bitmap_write(struct file *file, struct kobject *kobj,
 	return (char *)in - buf;
 }
 
+/*
+ * kidled: background working-set estimation.
+ *
+ * Every kidled_scan_period seconds all LRU pages are checked for
+ * references, exactly like a read of the bitmap followed by a write of
+ * all ones would do.  Each page's idle age, the number of consecutive
+ * scans it stayed idle, is kept in a byte per pfn and summed up into
+ * per-memcg histograms, which are published at the end of a full scan.
+ *
+ * Note that the scanner, userspace users of the bitmap and the NUMA
+ * balancing sampling mode all share the same idle flag, so no two of
+ * them should be used at the same time.
+ */
+const unsigned int kidled_bucket_age[KIDLED_NR_BUCKETS] = {
+	1, 2, 5, 15, 30, 60, 120, 240
+};
+
+unsigned int kidled_scan_period;
+unsigned long kidled_full_scans;
+
+static u8 *kidled_age;
+static unsigned long kidled_max_pfn;
+static DECLARE_WAIT_QUEUE_HEAD(kidled_wait);
+
+#define KIDLED_BATCH	1024
+
+static unsigned int kidled_bucket(unsigned int age)
+{
+	unsigned int i;
+
+	for (i = KIDLED_NR_BUCKETS - 1; i > 0; i--)
+		if (age >= kidled_bucket_age[i])
+			break;
+	return i;
+}
+
+static void kidled_scan_page(unsigned long pfn)
+{
+	struct mem_cgroup *memcg;
+	struct page *page;
+	unsigned int age;
+
+	page = page_idle_get_page(pfn);
+	if (!page) {
+		kidled_age[pfn] = 0;
+		return;
+	}
+
+	age = kidled_age[pfn];
+	if (page_is_idle(page))
+		page_idle_clear_pte_refs(page);
+	if (page_is_idle(page))
+		age = min(age + 1, (unsigned int)U8_MAX);
+	else
+		age = 0;
+	kidled_age[pfn] = age;
+	set_page_idle(page);
+
+	if (age) {
+		rcu_read_lock();
+		memcg = page->mem_cgroup;
+		if (memcg)
+			memcg->idle_scan.nr_pages[!!page_is_file_cache(page)]
+				[kidled_bucket(age)] += hpage_nr_pages(page);
+		rcu_read_unlock();
+	}
+	put_page(page);
+}
+
+static void kidled_publish(void)
+{
+	struct mem_cgroup *memcg;
+
+	for (memcg = mem_cgroup_iter(NULL, NULL, NULL); memcg;
+	     memcg = mem_cgroup_iter(NULL, memcg, NULL)) {
+		memcg->idle_stats = memcg->idle_scan;
+		memset(&memcg->idle_scan, 0, sizeof(memcg->idle_scan));
+	}
+	kidled_full_scans++;
+}
+
+/* Drop the partial histograms of an aborted scan */
+static void kidled_discard(void)
+{
+	struct mem_cgroup *memcg;
+
+	for (memcg = mem_cgroup_iter(NULL, NULL, NULL); memcg;
+	     memcg = mem_cgroup_iter(NULL, memcg, NULL))
+		memset(&memcg->idle_scan, 0, sizeof(memcg->idle_scan));
+}
+
+static bool kidled_should_abort(unsigned int period)
+{
+	return kthread_should_stop() ||
+	       READ_ONCE(kidled_scan_period) != period;
+}
+
+/*
+ * Sleep until @until, or until the period is changed or the thread is
+ * stopped.  Returns false in the latter case.
+ */
+static bool kidled_sleep_until(unsigned int period, unsigned long until)
+{
+	long timeout = (long)(until - jiffies);
+
+	if (timeout > 0)
+		wait_event_freezable_timeout(kidled_wait,
+					     kidled_should_abort(period),
+					     timeout);
+	else
+		cond_resched();
+
+	return !kidled_should_abort(period);
+}
+
+/*
+ * Spread one full scan over the scan period: after each batch sleep
+ * until the share of the period matching the share of memory covered
+ * has passed, then sleep out the rest of the period once all memory has
+ * been scanned.  Returns false if the scan was cut short because the
+ * period was changed or the thread stopped.
+ */
+static bool kidled_scan(unsigned int period)
+{
+	unsigned long start = jiffies;
+	u64 duration = (u64)period * HZ;
+	unsigned long pfn;
+
+	for (pfn = 0; pfn < kidled_max_pfn; pfn++) {
+		kidled_scan_page(pfn);
+
+		if ((pfn + 1) % KIDLED_BATCH)
+			continue;
+
+		if (!kidled_sleep_until(period, start +
+				(unsigned long)div64_u64(duration * (pfn + 1),
+							 kidled_max_pfn)))
+			return false;
+	}
+
+	return kidled_sleep_until(period, start + (unsigned long)duration);
+}
+
+static int kidled(void *dummy)
+{
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		unsigned int period = READ_ONCE(kidled_scan_period);
+
+		if (!period) {
+			wait_event_freezable(kidled_wait,
+					     READ_ONCE(kidled_scan_period) ||
+					     kthread_should_stop());
+			continue;
+		}
+
+		if (!kidled_age) {
+			kidled_max_pfn = max_pfn;
+			kidled_age = vzalloc(kidled_max_pfn);
+			if (!kidled_age) {
+				pr_err("kidled: cannot allocate page ages\n");
+				WRITE_ONCE(kidled_scan_period, 0);
+				continue;
+			}
+		}
+
+		if (kidled_scan(period))
+			kidled_publish();
+		else
+			kidled_discard();
+	}
+	return 0;
+}
+
+static ssize_t scan_period_secs_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", READ_ONCE(kidled_scan_period));
+}
+
+static ssize_t scan_period_secs_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
+{
+	unsigned int secs;
+	int err;
+
+	err = kstrtouint(buf, 10, &secs);
+	if (err)
+		return err;
+
+	WRITE_ONCE(kidled_scan_period, secs);
+	wake_up_interruptible(&kidled_wait);
+	return count;
+}
+
+static struct kobj_attribute scan_period_secs_attr =
+	__ATTR(scan_period_secs, 0644, scan_period_secs_show,
+	       scan_period_secs_store);
+
+static struct attribute *page_idle_attrs[] = {
+	&scan_period_secs_attr.attr,
+	NULL,
+};
+
 static struct bin_attribute page_idle_bitmap_attr =
 		__BIN_ATTR(bitmap, S_IRUSR | S_IWUSR,
 			   page_idle_bitmap_read, page_idle_bitmap_write, 0);
@@ -205,6 +417,7 @@ static struct bin_attribute *page_idle_bin_attrs[] = {
 };
 
 static struct attribute_group page_idle_attr_group = {
+	.attrs = page_idle_attrs,
 	.bin_attrs = page_idle_bin_attrs,
 	.name = "page_idle",
 };
@@ -221,6 +434,7 @@ struct page_ext_operations page_idle_ops = {
 
 static int __init page_idle_init(void)
 {
+	struct task_struct *tsk;
 	int err;
 
 	err = sysfs_create_group(mm_kobj, &page_idle_attr_group);
@@ -228,6 +442,10 @@ static int __init page_idle_init(void)
 		pr_err("page_idle: register sysfs failed\n");
 		return err;
 	}
+
+	tsk = kthread_run(kidled, NULL, "kidled");
+	if (IS_ERR(tsk))
+		pr_err("page_idle: failed to start kidled\n");
 	return 0;
 }
 subsys_initcall(page_idle_init);
@@ -97,6 +97,9 @@ struct scan_control {
 	/* Can pages be swapped as part of reclaim? */
 	unsigned int may_swap:1;
 
+	/* Proactive memcg reclaim asked to scan only the anon LRUs */
+	unsigned int anon_only:1;
+
 	/*
 	 * Cgroups are not reclaimed below their configured memory.low,
 	 * unless we threaten to OOM. If any cgroups are skipped due to
@@ -2128,6 +2131,22 @@ static void get_scan_count(struct lruvec *lruvec, struct mem_cgroup *memcg,
 	unsigned long ap, fp;
 	enum lru_list lru;
 
+	/*
+	 * Proactive reclaim from userspace may explicitly ask to push
+	 * anonymous memory out, e.g. to swap out idle containers while
+	 * keeping their page cache warm.  Never fall back to the file
+	 * LRUs for such a request: without swap there is nothing to do.
+	 */
+	if (sc->anon_only) {
+		if (mem_cgroup_get_nr_swap_pages(memcg) <= 0) {
+			*lru_pages = 0;
+			memset(nr, 0, sizeof(*nr) * NR_LRU_LISTS);
+			return;
+		}
+		scan_balance = SCAN_ANON;
+		goto out;
+	}
+
 	/* If we have no swap space, do not bother scanning anon pages. */
 	if (!sc->may_swap || mem_cgroup_get_nr_swap_pages(memcg) <= 0) {
 		scan_balance = SCAN_FILE;
@@ -3040,7 +3059,7 @@ unsigned long mem_cgroup_shrink_node(struct mem_cgroup *memcg,
 unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 					   unsigned long nr_pages,
 					   gfp_t gfp_mask,
-					   bool may_swap)
+					   unsigned int reclaim_options)
 {
 	struct zonelist *zonelist;
 	unsigned long nr_reclaimed;
@@ -3055,7 +3074,8 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 		.priority = DEF_PRIORITY,
 		.may_writepage = !laptop_mode,
 		.may_unmap = 1,
-		.may_swap = may_swap,
+		.may_swap = !!(reclaim_options & MEMCG_RECLAIM_MAY_SWAP),
+		.anon_only = !!(reclaim_options & MEMCG_RECLAIM_ANON_ONLY),
 	};
 
 	/*
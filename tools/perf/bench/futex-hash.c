@@ -31,6 +31,8 @@ static unsigned int nthreads = 0;
 static unsigned int nsecs    = 10;
 /* amount of futexes per thread */
 static unsigned int nfutexes = 1024;
+/* amount of processes running the benchmark */
+static unsigned int nprocs = 1;
 static bool fshared = false, done = false, silent = false;
 static int futex_flag = 0;
 
@@ -53,6 +55,7 @@ static const struct option options[] = {
 	OPT_UINTEGER('f', "futexes", &nfutexes, "Specify amount of futexes per threads"),
 	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
 	OPT_BOOLEAN( 'S', "shared",  &fshared,  "Use shared futexes instead of private ones"),
+	OPT_UINTEGER('p', "processes", &nprocs, "Run the benchmark in this many processes"),
 	OPT_END()
 };
 
@@ -116,6 +119,7 @@ static void print_summary(void)
 
 int bench_futex_hash(int argc, const char **argv)
 {
+	bool parent;
 	int ret = 0;
 	cpu_set_t cpu;
 	struct sigaction act;
@@ -129,6 +133,8 @@ int bench_futex_hash(int argc, const char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	parent = futex_bench_fork(nprocs);
+
 	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
 
 	sigfillset(&act.sa_mask);
@@ -214,6 +220,8 @@ int bench_futex_hash(int argc, const char **argv)
 	}
 
 	print_summary();
+	if (parent)
+		futex_bench_reap();
 
 	free(worker);
 	return ret;
@@ -39,6 +39,7 @@ static u_int32_t futex = 0;
 static pthread_t *blocked_worker;
 static bool done = false, silent = false, fshared = false;
 static unsigned int nblocked_threads = 0, nwaking_threads = 0;
+static unsigned int nprocs = 1;
 static pthread_mutex_t thread_lock;
 static pthread_cond_t thread_parent, thread_worker;
 static struct stats waketime_stats, wakeup_stats;
@@ -50,6 +51,7 @@ static const struct option options[] = {
 	OPT_UINTEGER('w', "nwakers", &nwaking_threads, "Specify amount of waking threads"),
 	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
 	OPT_BOOLEAN( 'S', "shared",  &fshared,  "Use shared futexes instead of private ones"),
+	OPT_UINTEGER('p', "processes", &nprocs, "Run the benchmark in this many processes"),
 	OPT_END()
 };
 
@@ -199,6 +201,7 @@ static void toggle_done(int sig __maybe_unused,
 
 int bench_futex_wake_parallel(int argc, const char **argv)
 {
+	bool parent;
 	int ret = 0;
 	unsigned int i, j;
 	struct sigaction act;
@@ -212,6 +215,8 @@ int bench_futex_wake_parallel(int argc, const char **argv)
 		exit(EXIT_FAILURE);
 	}
 
+	parent = futex_bench_fork(nprocs);
+
 	sigfillset(&act.sa_mask);
 	act.sa_sigaction = toggle_done;
 	sigaction(SIGINT, &act, NULL);
@@ -292,6 +297,8 @@ int bench_futex_wake_parallel(int argc, const char **argv)
 	pthread_attr_destroy(&thread_attr);
 
 	print_summary();
+	if (parent)
+		futex_bench_reap();
 
 	free(blocked_worker);
 	return ret;
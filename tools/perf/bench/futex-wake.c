@@ -6,6 +6,9 @@
  * This program is particularly useful to measure the latency of nthread wakeups
  * in non-error situations:  all waiters are queued and all wake calls wakeup
  * one or more tasks, and thus the waitqueue is never empty.
+ *
+ * With --multiple N, each thread instead waits with FUTEX_WAIT_MULTIPLE on N
+ * futexes, the one being woken and N-1 which never are.
  */
 
 /* For the CLR_() macros */
@@ -35,6 +38,11 @@ static u_int32_t futex1 = 0;
  */
 static unsigned int nwakes = 1;
 
+/* futexes each thread waits on, futex1 being the last one */
+static unsigned int nmultiple = 1;
+static struct futex_wait_block *wait_blocks;
+static u_int32_t *idle_futexes;
+
 pthread_t *worker;
 static bool done = false, silent = false, fshared = false;
 static pthread_mutex_t thread_lock;
@@ -48,6 +56,7 @@ static const struct option options[] = {
 	OPT_UINTEGER('w', "nwakes",  &nwakes,   "Specify amount of threads to wake at once"),
 	OPT_BOOLEAN( 's', "silent",  &silent,   "Silent mode: do not display data/details"),
 	OPT_BOOLEAN( 'S', "shared",  &fshared,  "Use shared futexes instead of private ones"),
+	OPT_UINTEGER('m', "multiple", &nmultiple, "Wait on this many futexes at once (FUTEX_WAIT_MULTIPLE)"),
 	OPT_END()
 };
 
@@ -66,7 +75,11 @@ static void *workerfn(void *arg __maybe_unused)
 	pthread_mutex_unlock(&thread_lock);
 
 	while (1) {
-		if (futex_wait(&futex1, 0, NULL, futex_flag) != EINTR)
+		if (nmultiple > 1) {
+			if (futex_wait_multiple(wait_blocks, nmultiple, NULL,
+						0) != EINTR)
+				break;
+		} else if (futex_wait(&futex1, 0, NULL, futex_flag) != EINTR)
 			break;
 	}
 
@@ -144,9 +157,29 @@ int bench_futex_wake(int argc, const char **argv)
 	if (!fshared)
 		futex_flag = FUTEX_PRIVATE_FLAG;
 
+	if (nmultiple > 1) {
+		if (nmultiple > FUTEX_WAIT_MULTIPLE_MAX)
+			errx(EXIT_FAILURE, "At most %d futexes can be waited on",
+			     FUTEX_WAIT_MULTIPLE_MAX);
+
+		wait_blocks = calloc(nmultiple, sizeof(*wait_blocks));
+		idle_futexes = calloc(nmultiple - 1, sizeof(*idle_futexes));
+		if (!wait_blocks || !idle_futexes)
+			err(EXIT_FAILURE, "calloc");
+
+		for (i = 0; i < nmultiple; i++) {
+			u_int32_t *f = i < nmultiple - 1 ? &idle_futexes[i] : &futex1;
+
+			wait_blocks[i].uaddr = (unsigned long)f;
+			wait_blocks[i].flags = futex_flag;
+		}
+	}
+
 	printf("Run summary [PID %d]: blocking on %d threads (at [%s] futex %p), "
 	       "waking up %d at a time.\n\n",
 	       getpid(), nthreads, fshared ? "shared":"private",  &futex1, nwakes);
+	if (nmultiple > 1)
+		printf("Each thread waits on %d futexes.\n\n", nmultiple);
 
 	init_stats(&wakeup_stats);
 	init_stats(&waketime_stats);
@@ -202,6 +235,8 @@ int bench_futex_wake(int argc, const char **argv)
 
 	print_summary();
 
+	free(idle_futexes);
+	free(wait_blocks);
 	free(worker);
 	return ret;
 }
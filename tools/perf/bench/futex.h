@@ -7,11 +7,26 @@
 #ifndef _FUTEX_H
 #define _FUTEX_H
 
+#include <err.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <linux/futex.h>
 
+#ifndef FUTEX_WAIT_MULTIPLE
+#define FUTEX_WAIT_MULTIPLE	13
+struct futex_wait_block {
+	__u64	uaddr;
+	__u32	val;
+	__u32	flags;
+};
+#define FUTEX_WAIT_MULTIPLE_MAX	128
+#endif
+
 /**
  * futex() - SYS_futex syscall wrapper
  * @uaddr:	address of first futex
@@ -86,6 +101,51 @@ futex_cmp_requeue(u_int32_t *uaddr, u_int32_t val, u_int32_t *uaddr2, int nr_wak
 		 val, opflags);
 }
 
+/**
+ * futex_wait_multiple() - block on several futexes at once
+ * @wb:		array of futexes, expected values and flags
+ * @count:	number of entries in wb
+ *
+ * Returns the index of the futex that was woken.
+ */
+static inline int
+futex_wait_multiple(struct futex_wait_block *wb, int count,
+		    struct timespec *timeout, int opflags)
+{
+	return futex(wb, FUTEX_WAIT_MULTIPLE, count, timeout, NULL, 0, opflags);
+}
+
+/**
+ * futex_bench_fork() - run the benchmark in @nprocs processes
+ *
+ * Running several copies side by side shows how the futex hash scales
+ * across processes, as opposed to across the threads of one: private
+ * futexes of different processes live in separate hash tables and should
+ * not contend on the buckets. The copies report their results separately.
+ * Returns true in the parent, which must call futex_bench_reap() when done.
+ */
+static inline bool futex_bench_fork(unsigned int nprocs)
+{
+	unsigned int i;
+
+	fflush(stdout);
+	for (i = 1; i < nprocs; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0)
+			err(EXIT_FAILURE, "fork");
+		if (!pid)
+			return false;
+	}
+	return true;
+}
+
+static inline void futex_bench_reap(void)
+{
+	while (wait(NULL) > 0)
+		;
+}
+
 #ifndef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
 #include <pthread.h>
 #include <linux/compiler.h>
@@ -37,6 +37,7 @@ static bool use_pipes = false;
 static unsigned int nr_loops = 100;
 static bool thread_mode = false;
 static unsigned int num_groups = 10;
+static bool show_wakeups = false;
 
 struct sender_context {
 	unsigned int num_fds;
@@ -252,6 +253,8 @@ static const struct option options[] = {
 		    "Be multi thread instead of multi process"),
 	OPT_UINTEGER('g', "group", &num_groups, "Specify number of groups"),
 	OPT_UINTEGER('l', "nr_loops", &nr_loops, "Specify the number of loops to run (default: 100)"),
+	OPT_BOOLEAN('w', "wakeups", &show_wakeups,
+		    "Also report message (wakeup) throughput"),
 	OPT_END()
 };
 
@@ -265,6 +268,7 @@ int bench_sched_messaging(int argc, const char **argv)
 	unsigned int i, total_children;
 	struct timeval start, stop, diff;
 	unsigned int num_fds = 20;
+	unsigned long long nr_msgs, usecs;
 	int readyfds[2], wakefds[2];
 	char dummy;
 	pthread_t *pth_tab;
@@ -303,6 +307,12 @@ int bench_sched_messaging(int argc, const char **argv)
 
 	timersub(&stop, &start, &diff);
 
+	/* Every sender writes nr_loops messages to each receiver of its group */
+	nr_msgs = (unsigned long long)num_groups * num_fds * num_fds * nr_loops;
+	usecs = diff.tv_sec * USEC_PER_SEC + diff.tv_usec;
+	if (!usecs)
+		usecs = 1;
+
 	switch (bench_format) {
 	case BENCH_FORMAT_DEFAULT:
 		printf("# %d sender and receiver %s per group\n",
@@ -313,10 +323,18 @@ int bench_sched_messaging(int argc, const char **argv)
 		printf(" %14s: %lu.%03lu [sec]\n", "Total time",
 		       diff.tv_sec,
 		       (unsigned long) (diff.tv_usec / USEC_PER_MSEC));
+		if (show_wakeups) {
+			printf(" %14s: %llu\n", "Messages", nr_msgs);
+			printf(" %14s: %llu [msgs/sec]\n", "Throughput",
+			       nr_msgs * USEC_PER_SEC / usecs);
+		}
 		break;
 	case BENCH_FORMAT_SIMPLE:
-		printf("%lu.%03lu\n", diff.tv_sec,
-		       (unsigned long) (diff.tv_usec / USEC_PER_MSEC));
+		if (show_wakeups)
+			printf("%llu\n", nr_msgs * USEC_PER_SEC / usecs);
+		else
+			printf("%lu.%03lu\n", diff.tv_sec,
+			       (unsigned long) (diff.tv_usec / USEC_PER_MSEC));
 		break;
 	default:
 		/* reaching here is something disaster */
@@ -0,0 +1,166 @@
+/******************************************************************************
+ *
+ *   This program is free software;  you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ * DESCRIPTION
+ *      Test FUTEX_WAIT_MULTIPLE: it must return -EWOULDBLOCK if any futex
+ *      value differs from the expected one, time out, and return the index
+ *      of the futex which was woken, for private and shared futexes.
+ *
+ *****************************************************************************/
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "futextest.h"
+#include "logging.h"
+
+#define NR_FUTEXES	8
+#define TIMEOUT_NS	100000000	/* 100ms */
+
+static futex_t futexes[NR_FUTEXES];
+static struct futex_wait_block wb[NR_FUTEXES];
+static int waiter_ret, waiter_errno;
+
+void usage(char *prog)
+{
+	printf("Usage: %s\n", prog);
+	printf("  -c	Use color\n");
+	printf("  -h	Display this help message\n");
+	printf("  -v L	Verbosity level: %d=QUIET %d=CRITICAL %d=INFO\n",
+	       VQUIET, VCRITICAL, VINFO);
+}
+
+static void init_blocks(void)
+{
+	int i;
+
+	for (i = 0; i < NR_FUTEXES; i++) {
+		futexes[i] = FUTEX_INITIALIZER;
+		wb[i].uaddr = (unsigned long)&futexes[i];
+		wb[i].val = FUTEX_INITIALIZER;
+		/* mix private and shared futexes */
+		wb[i].flags = i & 1 ? 0 : FUTEX_PRIVATE_FLAG;
+	}
+}
+
+static void abs_timeout(struct timespec *to, long ns)
+{
+	clock_gettime(CLOCK_MONOTONIC, to);
+	to->tv_nsec += ns;
+	to->tv_sec += to->tv_nsec / 1000000000;
+	to->tv_nsec %= 1000000000;
+}
+
+static void *waiterfn(void *arg)
+{
+	waiter_ret = futex_wait_multiple(wb, NR_FUTEXES, NULL, 0);
+	waiter_errno = errno;
+	return NULL;
+}
+
+static int test_wake(int idx)
+{
+	pthread_t waiter;
+	int woken = 0, tries;
+
+	init_blocks();
+	if (pthread_create(&waiter, NULL, waiterfn, NULL)) {
+		error("pthread_create\n", errno);
+		return RET_ERROR;
+	}
+
+	/* wait for the waiter to block, then wake it through futexes[idx] */
+	for (tries = 0; tries < 100 && !woken; tries++) {
+		usleep(10000);
+		woken = futex_wake(&futexes[idx], 1,
+				   wb[idx].flags & FUTEX_PRIVATE_FLAG);
+	}
+	if (!woken) {
+		fail("waiter not woken through futex %d\n", idx);
+		return RET_FAIL;
+	}
+
+	pthread_join(waiter, NULL);
+	info("futex_wait_multiple returned %d, expected %d\n",
+	     waiter_ret, idx);
+	if (waiter_ret != idx) {
+		fail("futex_wait_multiple returned: %d %s\n", waiter_ret,
+		     waiter_ret < 0 ? strerror(waiter_errno) : "");
+		return RET_FAIL;
+	}
+	return RET_PASS;
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec to;
+	int res, ret = RET_PASS;
+	int c;
+
+	while ((c = getopt(argc, argv, "chv:")) != -1) {
+		switch (c) {
+		case 'c':
+			log_color(1);
+			break;
+		case 'h':
+			usage(basename(argv[0]));
+			exit(0);
+		case 'v':
+			log_verbosity(atoi(optarg));
+			break;
+		default:
+			usage(basename(argv[0]));
+			exit(1);
+		}
+	}
+
+	printf("%s: Test FUTEX_WAIT_MULTIPLE\n", basename(argv[0]));
+
+	init_blocks();
+	wb[NR_FUTEXES - 1].val = FUTEX_INITIALIZER + 1;
+	abs_timeout(&to, TIMEOUT_NS);
+	info("Calling futex_wait_multiple with one unexpected value\n");
+	res = futex_wait_multiple(wb, NR_FUTEXES, &to, 0);
+	if (!res || errno != EWOULDBLOCK) {
+		fail("futex_wait_multiple returned: %d %s\n",
+		     res ? errno : res, res ? strerror(errno) : "");
+		ret = RET_FAIL;
+	}
+
+	init_blocks();
+	abs_timeout(&to, TIMEOUT_NS);
+	info("Calling futex_wait_multiple with a timeout\n");
+	res = futex_wait_multiple(wb, NR_FUTEXES, &to, 0);
+	if (!res || errno != ETIMEDOUT) {
+		fail("futex_wait_multiple returned: %d %s\n",
+		     res ? errno : res, res ? strerror(errno) : "");
+		ret = RET_FAIL;
+	}
+
+	init_blocks();
+	wb[0].flags = FUTEX_CLOCK_REALTIME;
+	info("Calling futex_wait_multiple with invalid flags\n");
+	res = futex_wait_multiple(wb, NR_FUTEXES, NULL, 0);
+	if (!res || errno != EINVAL) {
+		fail("futex_wait_multiple returned: %d %s\n",
+		     res ? errno : res, res ? strerror(errno) : "");
+		ret = RET_FAIL;
+	}
+
+	for (c = 0; c < NR_FUTEXES; c += 3) {
+		res = test_wake(c);
+		if (res != RET_PASS)
+			ret = res;
+	}
+
+	print_result(ret);
+	return ret;
+}
@@ -0,0 +1,178 @@
+#!/usr/bin/python
+#
+# wq_top - live view of the workqueue statistics (CONFIG_WQ_STATS)
+#
+# Periodically samples <debugfs>/workqueue/stats and funcs and prints the
+# per-interval deltas, busiest workqueues first:
+#
+#   queued/s	work items queued per second
+#   started/s	work items started per second
+#   cmwake	concurrency management wakeups in the interval
+#   hogs	work items that used more than cpu_hog_thresh_us of CPU
+#   lat_avg	average queue-to-start latency of the started work items
+#   lat_p99	upper bound of the 99th percentile latency bucket
+#   exec%	execution time as a percentage of one CPU
+#
+# followed by the work functions which executed longest in the interval.
+#
+# Licensed under the terms of the GNU GPL License version 2
+
+from __future__ import print_function
+
+import optparse
+import os
+import sys
+import time
+
+NR_BUCKETS = 16
+
+
+def bucket_limit_us(b):
+    # bucket 0 is < 1us, bucket b is [2^(b-1), 2^b) us
+    return 1 << b
+
+
+def fmt_us(us):
+    if us >= 1000000:
+        return '%.1fs' % (us / 1000000.0)
+    if us >= 1000:
+        return '%.1fms' % (us / 1000.0)
+    return '%dus' % us
+
+
+def read_stats(path):
+    stats = {}
+    with open(os.path.join(path, 'stats')) as f:
+        for line in f:
+            if line.startswith('#'):
+                continue
+            fields = line.split()
+            nr = 6 + NR_BUCKETS
+            if len(fields) <= nr:
+                continue
+            name = ' '.join(fields[:-nr])
+            vals = [int(v) for v in fields[-nr:]]
+            stats[name] = vals
+    return stats
+
+
+def read_funcs(path):
+    funcs = {}
+    with open(os.path.join(path, 'funcs')) as f:
+        for line in f:
+            if line.startswith('#'):
+                continue
+            fields = line.split(None, 4)
+            if len(fields) < 5:
+                continue
+            funcs[fields[4].strip()] = (int(fields[0]), int(fields[1]),
+                                        int(fields[3]))
+    return funcs
+
+
+def write_knob(path, name, val):
+    with open(os.path.join(path, name), 'w') as f:
+        f.write(val)
+
+
+def p99(hist):
+    total = sum(hist)
+    if not total:
+        return 0
+    acc = 0
+    for b, n in enumerate(hist):
+        acc += n
+        if acc * 100 >= total * 99:
+            return bucket_limit_us(b)
+    return bucket_limit_us(NR_BUCKETS - 1)
+
+
+def show(prev, cur, pfuncs, cfuncs, interval, opts):
+    rows = []
+    for name, c in cur.items():
+        p = prev.get(name, [0] * len(c))
+        d = [a - b for a, b in zip(c, p)]
+        if not opts.all and not d[0] and not d[1]:
+            continue
+        rows.append((name, d))
+    rows.sort(key=lambda r: r[1][5], reverse=True)
+
+    print('%-24s %9s %10s %7s %5s %8s %8s %6s' %
+          ('workqueue', 'queued/s', 'started/s', 'cmwake', 'hogs',
+           'lat_avg', 'lat_p99', 'exec%'))
+    for name, d in rows[:opts.lines]:
+        hist = d[6:]
+        nlat = sum(hist)
+        print('%-24s %9.1f %10.1f %7d %5d %8s %8s %6.1f' %
+              (name[:24], d[0] / interval, d[1] / interval, d[2], d[3],
+               fmt_us(d[4] // nlat if nlat else 0),
+               fmt_us(p99(hist)),
+               d[5] / (interval * 10000.0)))
+
+    frows = []
+    for func, c in cfuncs.items():
+        p = pfuncs.get(func, (0, 0, 0))
+        cnt, total = c[0] - p[0], c[1] - p[1]
+        if cnt > 0:
+            frows.append((func, cnt, total, c[2]))
+    frows.sort(key=lambda r: r[2], reverse=True)
+
+    print()
+    print('%-40s %9s %10s %9s %9s' %
+          ('function', 'count', 'total', 'avg', 'max(all)'))
+    for func, cnt, total, mx in frows[:opts.lines]:
+        print('%-40s %9d %10s %9s %9s' %
+              (func[:40], cnt, fmt_us(total), fmt_us(total // cnt),
+               fmt_us(mx)))
+
+
+def main():
+    parser = optparse.OptionParser(usage='%prog [options]')
+    parser.add_option('-d', '--debugfs', default='/sys/kernel/debug',
+                      help='debugfs mount point')
+    parser.add_option('-i', '--interval', type='float', default=1.0,
+                      help='sampling interval in seconds')
+    parser.add_option('-n', '--lines', type='int', default=20,
+                      help='number of workqueues and functions to show')
+    parser.add_option('-a', '--all', action='store_true', default=False,
+                      help='also show idle workqueues')
+    parser.add_option('-e', '--enable', action='store_true', default=False,
+                      help='enable collection and disable it again on exit')
+    parser.add_option('-r', '--reset', action='store_true', default=False,
+                      help='reset the statistics before starting')
+    parser.add_option('-o', '--once', action='store_true', default=False,
+                      help='print a single interval and exit')
+    opts, args = parser.parse_args()
+
+    path = os.path.join(opts.debugfs, 'workqueue')
+    if not os.path.exists(os.path.join(path, 'stats')):
+        sys.exit('%s not found; is debugfs mounted and CONFIG_WQ_STATS set?'
+                 % path)
+
+    try:
+        if opts.reset:
+            write_knob(path, 'reset', '1')
+        if opts.enable:
+            write_knob(path, 'enable', '1')
+
+        prev, pfuncs = read_stats(path), read_funcs(path)
+        while True:
+            time.sleep(opts.interval)
+            cur, cfuncs = read_stats(path), read_funcs(path)
+            if not opts.once:
+                sys.stdout.write('\033[H\033[J')
+            print(time.strftime('%H:%M:%S'), ' interval %.1fs' % opts.interval)
+            show(prev, cur, pfuncs, cfuncs, opts.interval, opts)
+            sys.stdout.flush()
+            if opts.once:
+                break
+            prev, pfuncs = cur, cfuncs
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if opts.enable:
+            write_knob(path, 'enable', '0')
+
+
+if __name__ == '__main__':
+    main()